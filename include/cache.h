@@ -0,0 +1,22 @@
+#ifndef BASIL_CACHE_H
+#define BASIL_CACHE_H
+
+#include "defs.h"
+#include "str.h"
+
+namespace basil {
+    // Cached modules are stored next to their source, as '<path>c'.
+    string cachePath(const char* path);
+
+    // Hashes a module's source together with those of the modules it
+    // uses, transitively.
+    u64 sourceKey(const Source& src);
+
+    // Returns the cached syntax tree for a module whose source hashes
+    // to the stored key, or nullptr if there is no valid cache entry.
+    ProgramTerm* loadCachedModule(const char* path, const Source& src);
+    void cacheModule(const char* path, const Source& src,
+                     const ProgramTerm* body);
+}
+
+#endif
@@ -6,12 +6,44 @@
 #include "vec.h"
 
 namespace basil {
+    // Message text captured for an error raised while errors are being
+    // caught, formatted only if the error is ever reported or printed.
+    class DeferredMessage {
+    public:
+        DeferredMessage* next;
+
+        DeferredMessage();
+        virtual ~DeferredMessage();
+        virtual void format(buffer& b) const = 0;
+    };
+
+    template<typename Func>
+    class DeferredMessageOf : public DeferredMessage {
+        Func _func;
+    public:
+        DeferredMessageOf(const Func& func): _func(func) {
+            //
+        }
+
+        void format(buffer& b) const override {
+            _func(b);
+        }
+    };
+
+    template<typename Func>
+    DeferredMessage* defer(const Func& func) {
+        return new DeferredMessageOf<Func>(func);
+    }
+
     struct Error {
         const Source* src;
         u32 line, column;
         buffer message;
+        DeferredMessage* deferred;
 
         Error();
+        void resolve();
+        void discard();
         void format(stream& io) const;
     };
 
@@ -26,6 +58,7 @@ namespace basil {
     u32 countErrors();
     void printErrors(stream& io);
 
+    bool catchingErrors();
     void catchErrors();
     void releaseErrors();
     void discardErrors();
@@ -33,31 +66,42 @@ namespace basil {
 
     template<typename... Args>
     void err(Phase phase, u32 line, u32 column, const Args&... args) {
-        buffer b;
-        fprint(b, "(", line, ":", column, ") ", args...);
         Error e;
         e.line = line, e.column = column;
-        e.message = b;
         e.src = nullptr;
+        if (catchingErrors()) e.deferred = defer([=](buffer& b) {
+            fprint(b, "(", line, ":", column, ") ", args...);
+        });
+        else fprint(e.message, "(", line, ":", column, ") ", args...);
         reportError(e);
     }
 
     template<typename... Args>
     void err(Phase phase, const Source* src, u32 line, u32 column, const Args&... args) {
-        buffer b;
-        fprint(b, "(", line, ":", column, ") ", args...);
         Error e;
         e.line = line, e.column = column;
-        e.message = b;
         e.src = src;
+        if (catchingErrors()) e.deferred = defer([=](buffer& b) {
+            fprint(b, "(", line, ":", column, ") ", args...);
+        });
+        else fprint(e.message, "(", line, ":", column, ") ", args...);
         reportError(e);
     }
 
     template<typename... Args>
     void note(Phase phase, u32 line, u32 column, const Args&... args) {
+        Error& e = lastError();
+        if (e.deferred) {
+            DeferredMessage* last = e.deferred;
+            while (last->next) last = last->next;
+            last->next = defer([=](buffer& b) {
+                fprint(b, "\n(", line, ":", column, ") - ", args...);
+            });
+            return;
+        }
         buffer b;
         fprint(b, "(", line, ":", column, ") - ", args...);
-        fprint(lastError().message, "\n", b);
+        fprint(e.message, "\n", b);
     }
 }
 
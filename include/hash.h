@@ -5,6 +5,7 @@
 #include "str.h"
 #include <new>
 #include <initializer_list>
+#include <utility>
 #include <iostream>
 
 template<typename T, typename U>
@@ -85,11 +86,11 @@ class set {
             return *(T*)data;
         }
 
-        inline void fill(const T& value) {
+        inline void fill(T&& value) {
             if (status != FILLED) {
-                status = FILLED, new(data) T(value);
+                status = FILLED, new(data) T(std::move(value));
             }
-            else this->value() = value;
+            else this->value() = std::move(value);
         }
 
         inline void evict() {
@@ -122,9 +123,9 @@ class set {
     }
 
     void swap(T& a, T& b) {
-        T t = a;
-        a = b;
-        b = t;
+        T t = std::move(a);
+        a = std::move(b);
+        b = std::move(t);
     }
 
     void free() {
@@ -143,11 +144,42 @@ class set {
         init(_capacity * 2);
         _mask = (_mask << 1) | 1;
         for (u32 i = 0; i < oldsize; ++ i) {
-            if (old[i].status == FILLED) insert(old[i].value());
+            if (old[i].status == FILLED) place(old[i].value());
         }
         delete[] old;
     }
 
+    // Inserts item, moving from it.
+    void place(T& item) {
+        u64 h = hash(item);
+        u64 dist = 0;
+        u64 i = h & _mask;
+        while (true) {
+            if (data[i].status == EMPTY || data[i].status == GHOST) {
+                data[i].fill(std::move(item));
+                ++ _size;
+                return;
+            }
+
+            if (data[i].status == FILLED && equals(data[i].value(), item)) {
+                return;
+            }
+
+            u64 other_dist = (i - (hash(data[i].value()) & _mask)) & _mask;
+            if (other_dist < dist) {
+                if (data[i].status == GHOST) {
+                    data[i].fill(std::move(item));
+                    ++ _size;
+                    return;
+                }
+                swap(item, data[i].value());
+                dist = other_dist;
+            }
+            i = (i + 1) & _mask;
+            ++ dist;
+        }
+    }
+
 public:
     set(bool (*equals_in)(const T&, const T&) = ::equals,
         u64 (*hash_in)(const T&) = ::hash<T>): 
@@ -284,34 +316,13 @@ public:
 
     void insert(const T& t) {
         if (double(_size + 1) / double(_capacity) > 0.625) grow();
-        u64 h = hash(t);
-        u64 dist = 0;
-        u64 i = h & _mask;
         T item = t;
-        while (true) {
-            if (data[i].status == EMPTY || data[i].status == GHOST) {
-                data[i].fill(item);
-                ++ _size;
-                return;
-            }
-
-            if (data[i].status == FILLED && equals(data[i].value(), item)) {
-                return;
-            }
+        place(item);
+    }
 
-            u64 other_dist = (i - (hash(data[i].value()) & _mask)) & _mask;
-            if (other_dist < dist) {
-                if (data[i].status == GHOST) {
-                    data[i].fill(item);
-                    ++ _size;
-                    return;
-                }
-                swap(item, data[i].value());
-                dist = other_dist;
-            }
-            i = (i + 1) & _mask;
-            ++ dist;
-        }
+    void insert(T&& t) {
+        if (double(_size + 1) / double(_capacity) > 0.625) grow();
+        place(t);
     }
 
     void erase(const T& t) {
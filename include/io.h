@@ -60,7 +60,7 @@ public:
     const u8* end() const;
 };
 
-extern stream &_stdin, &_stdout;
+extern stream &_stdin, &_stdout, &_stderr;
 void setprecision(u32 p);
 
 void print(stream& io, u8 c);
@@ -118,7 +118,10 @@ namespace basil {
         void returns(const Type* ret) override;
         void format(stream& io);
         const ustring& label() const;
+        string canonicalX86(const buffer& body) const;
 
+        void emitX86Labels(buffer& text, buffer& data);
+        void emitX86Body(buffer& text, buffer& data);
         void emitX86(buffer& text, buffer& data);
     };
     
@@ -3,6 +3,7 @@
 
 #include "defs.h"
 #include "vec.h"
+#include "pvec.h"
 #include "hash.h"
 #include "utf8.h"
 #include "io.h"
@@ -11,8 +12,19 @@ namespace basil {
     extern u64 findSymbol(const ustring& name);
     extern const ustring& findSymbol(u64 name);
 
+    // Representation of a Meta's value, derived once from its type.
+    enum MetaKind : u8 {
+        META_NONE, META_VOID, META_INT, META_FLOAT, META_TYPE, META_BOOL,
+        META_SYMBOL, META_REF, META_OTHER, 
+        
+        // kinds from here on hold a reference-counted value
+        META_STRING, META_LIST, META_TUPLE, META_ARRAY, META_UNION, 
+        META_INTERSECT, META_FUNCTION
+    };
+
     class Meta {
         const Type* _type;
+        MetaKind _kind;
         union {
             i64 i;
             double d;
@@ -26,12 +38,17 @@ namespace basil {
             MetaUnion* un;
             MetaIntersect* in;
             MetaFunction* f;
+            MetaRC* rc;
         } value;
 
         void free();
         void copy(const Meta& other);
         void assign(const Meta& other);
     public:
+#ifdef BASIL_STATS
+        static u64 copies; // total copies made, for -stats
+#endif
+
         Meta();
         Meta(const Type* type);
         Meta(const Type* type, i64 i);
@@ -48,8 +65,11 @@ namespace basil {
         Meta(const Type* type, MetaFunction* f);
         ~Meta();
         Meta(const Meta& other);
+        Meta(Meta&& other);
         Meta& operator=(const Meta& other);
+        Meta& operator=(Meta&& other);
         const Type* type() const;
+        MetaKind kind() const;
         bool isVoid() const;
         bool isInt() const;
         i64 asInt() const;
@@ -102,6 +122,10 @@ namespace basil {
     class MetaRC {
         u32 rc;
     public:
+#ifdef BASIL_STATS
+        static u64 incs, decs; // total refcount updates, for -stats
+#endif
+        
         MetaRC();
         virtual ~MetaRC();
         void inc();
@@ -146,15 +170,24 @@ namespace basil {
     };
 
     class MetaArray : public MetaRC {
-        vector<Meta> vals;
+        mutable pvector<Meta> vals;
+        i64 _first;
+        mutable u32 _lazy; // integers from _first not yet in vals
+
+        void materialize() const;
     public:
+        MetaArray();
         MetaArray(const vector<Meta>& values);
-        const Meta& operator[](u32 i) const;
+        MetaArray(const pvector<Meta>& values);
+        MetaArray(i64 first, u32 count);
+        Meta operator[](u32 i) const;
         Meta& operator[](u32 i);
-        const Meta* begin() const;
-        const Meta* end() const;
-        Meta* begin();
-        Meta* end();
+        const Meta& at(u32 i) const;
+        bool lazy() const;
+        pvector<Meta>::const_iterator begin() const;
+        pvector<Meta>::const_iterator end() const;
+        const pvector<Meta>& values() const;
+        void push(const Meta& m);
         u32 size() const;
         Meta clone(const Meta& src) const override;
     };
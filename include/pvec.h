@@ -0,0 +1,231 @@
+#ifndef BASIL_PVECTOR_H
+#define BASIL_PVECTOR_H
+
+#include "defs.h"
+#include "vec.h"
+
+// Persistent vector: a 32-way trie whose nodes are shared between copies.
+// Copying is O(1); push and mutable access copy only the nodes on the path
+// to the affected element, and only when those nodes are shared. While the
+// vector fits in one leaf, that leaf is sized to its contents.
+template<typename T>
+class pvector {
+    static const u32 BITS = 5, WIDTH = 1 << BITS, MASK = WIDTH - 1;
+
+    struct node {
+        u32 rc;
+        bool leaf;
+
+        node(bool leaf_in): rc(1), leaf(leaf_in) {
+            //
+        }
+    };
+
+    struct branch : public node {
+        node* kids[WIDTH];
+
+        branch(): node(false) {
+            for (u32 i = 0; i < WIDTH; i ++) kids[i] = nullptr;
+        }
+    };
+
+    // Leaves keep their values inline, right after the header.
+    struct leaf : public node {
+        u32 cap;
+
+        leaf(u32 cap_in): node(true), cap(cap_in) {
+            //
+        }
+
+        T* vals() {
+            return (T*)((u8*)this + OFFSET);
+        }
+
+        const T* vals() const {
+            return (const T*)((const u8*)this + OFFSET);
+        }
+    };
+
+    static const u32 OFFSET = 
+        (sizeof(leaf) + alignof(T) - 1) / alignof(T) * alignof(T);
+
+    node* root;
+    u32 _size, shift;
+
+    static void retain(node* n) {
+        if (n) n->rc ++;
+    }
+
+    static leaf* newleaf(u32 cap) {
+        leaf* l = new(new u8[OFFSET + cap * sizeof(T)]) leaf(cap);
+        for (u32 i = 0; i < cap; i ++) new(l->vals() + i) T();
+        return l;
+    }
+
+    static void freeleaf(leaf* l) {
+        for (u32 i = 0; i < l->cap; i ++) l->vals()[i].~T();
+        l->~leaf();
+        delete[] (u8*)l;
+    }
+
+    static void release(node* n) {
+        if (!n || -- n->rc > 0) return;
+        if (n->leaf) freeleaf((leaf*)n);
+        else {
+            branch* b = (branch*)n;
+            for (u32 i = 0; i < WIDTH; i ++) release(b->kids[i]);
+            delete b;
+        }
+    }
+
+    // Replaces the leaf n with an unshared copy with room for cap values.
+    static void resize(node*& n, u32 cap) {
+        const leaf* old = (const leaf*)n;
+        leaf* l = newleaf(cap);
+        for (u32 i = 0; i < cap && i < old->cap; i ++) 
+            l->vals()[i] = old->vals()[i];
+        release(n);
+        n = l;
+    }
+
+    // Makes sure n is not shared with any other vector.
+    static void unique(node*& n) {
+        if (n->rc == 1) return;
+        if (n->leaf) return resize(n, ((leaf*)n)->cap);
+        branch* b = new branch();
+        for (u32 i = 0; i < WIDTH; i ++) {
+            b->kids[i] = ((branch*)n)->kids[i];
+            retain(b->kids[i]);
+        }
+        n->rc --;
+        n = b;
+    }
+
+    const leaf* find(u32 i) const {
+        const node* n = root;
+        for (u32 s = shift; s > 0; s -= BITS)
+            n = ((const branch*)n)->kids[(i >> s) & MASK];
+        return (const leaf*)n;
+    }
+
+    // Returns the unshared leaf holding index i, creating missing nodes
+    // along the way. A leaf too small for i grows to at least fit values,
+    // doubling if that's larger.
+    leaf* path(u32 i, u32 fit = WIDTH) {
+        node** n = &root;
+        for (u32 s = shift; s > 0; s -= BITS) {
+            if (!*n) *n = new branch();
+            unique(*n);
+            n = &((branch*)*n)->kids[(i >> s) & MASK];
+        }
+        if (!*n) *n = newleaf(fit);
+        else if (((leaf*)*n)->cap <= (i & MASK)) {
+            u32 cap = ((leaf*)*n)->cap * 2;
+            if (cap < fit) cap = fit;
+            resize(*n, cap < WIDTH ? cap : WIDTH);
+        }
+        else unique(*n);
+        return (leaf*)*n;
+    }
+
+public:
+    pvector(): root(nullptr), _size(0), shift(0) {
+        //
+    }
+
+    pvector(const vector<T>& ts): pvector() {
+        if (ts.size() > 0 && ts.size() < WIDTH) root = newleaf(ts.size());
+        for (const T& t : ts) push(t);
+    }
+
+    ~pvector() {
+        release(root);
+    }
+
+    pvector(const pvector& other):
+        root(other.root), _size(other._size), shift(other.shift) {
+        retain(root);
+    }
+
+    pvector& operator=(const pvector& other) {
+        if (this != &other) {
+            retain(other.root);
+            release(root);
+            root = other.root, _size = other._size, shift = other.shift;
+        }
+        return *this;
+    }
+
+    void push(const T& t) {
+        if (root && _size == (1u << (shift + BITS))) {
+            branch* b = new branch();
+            b->kids[0] = root;
+            root = b;
+            shift += BITS;
+        }
+        u32 fit = _size < WIDTH ? (_size & MASK) + 1 : WIDTH;
+        path(_size, fit)->vals()[_size & MASK] = t;
+        ++ _size;
+    }
+
+    const T& operator[](u32 i) const {
+        return find(i)->vals()[i & MASK];
+    }
+
+    T& operator[](u32 i) {
+        return path(i)->vals()[i & MASK];
+    }
+
+    u32 size() const {
+        return _size;
+    }
+
+    class const_iterator {
+        const pvector* v;
+        u32 i;
+        mutable const leaf* l;
+    public:
+        const_iterator(const pvector* v_in, u32 i_in):
+            v(v_in), i(i_in), l(nullptr) {
+            //
+        }
+
+        const T& operator*() const {
+            if (!l) l = v->find(i);
+            return l->vals()[i & MASK];
+        }
+
+        const T* operator->() const {
+            return &operator*();
+        }
+
+        const_iterator& operator++() {
+            if ((++ i & MASK) == 0) l = nullptr;
+            return *this;
+        }
+
+        const_iterator operator++(int) {
+            const_iterator it = *this;
+            operator++();
+            return it;
+        }
+
+        bool operator==(const const_iterator& other) const {
+            return i == other.i;
+        }
+
+        bool operator!=(const const_iterator& other) const {
+            return i != other.i;
+        }
+    };
+
+    const_iterator begin() const {
+        return const_iterator(this, 0);
+    }
+
+    const_iterator end() const {
+        return const_iterator(this, _size);
+    }
+};
+
+#endif
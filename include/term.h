@@ -190,6 +190,7 @@ namespace basil {
 
     class VariableTerm : public Term {
         ustring _name;
+        u64 _symbol;
     public:
         static const TermClass CLASS;
 
@@ -208,6 +209,10 @@ namespace basil {
     };
 
     class BlockTerm : public Term {
+        // quoted blocks are folded and typed again on every lowering,
+        // so both results are kept until the block changes
+        mutable const Type* _cachetype;
+        mutable Meta _cachefold;
     public:
         static const TermClass CLASS;
 
@@ -239,6 +244,7 @@ namespace basil {
         void add(Term* child);  
         virtual void format(stream& io, u32 level = 0) const override;  
         virtual void eval(Stack& stack) override;
+        void evalLazily(Stack& stack);
         void evalChild(Stack& stack, Term* t);
         Stack& scope();
         virtual bool equals(const Term* other) const override;
@@ -18,19 +18,21 @@ namespace basil {
         ustring _key;
         Constraint(ConstraintType type);
     public:
-        Constraint(Meta value);
+        Constraint(const Meta& value);
         Constraint(const Type* type);
         Constraint();
 
         const static Constraint NONE;
 
         ConstraintType type() const;
-        Meta value() const;
+        const Meta& value() const;
         bool conflictsWith(const Constraint& other) const;
         bool precedes(const Constraint& other) const;
-        bool matches(Meta value) const;
+        bool matches(const Meta& value) const;
         const ustring& key() const;
         operator bool() const;
+        bool operator==(const Constraint& other) const;
+        u64 hash() const;
     };
 
     class TypeClass {
@@ -48,19 +50,26 @@ namespace basil {
         ustring _key;
         u32 _size;
         u32 _id;
+
+        virtual bool lazyImplicitly(const Type* other) const;
+        virtual bool lazyExplicitly(const Type* other) const;
     public:
         static const TypeClass CLASS;
 
         Type(const ustring& key, u32 size, const TypeClass* tc = &CLASS);
         
         u32 size() const;
-        virtual bool implicitly(const Type* other) const;
-        virtual bool explicitly(const Type* other) const;
+        bool implicitly(const Type* other) const;
+        bool explicitly(const Type* other) const;
         virtual bool conflictsWith(const Type* other) const;
         virtual bool wildcard() const;
         const ustring& key() const;
         virtual void format(stream& io) const;
         u32 id() const;
+        const TypeClass* typeclass() const;
+
+        static u64 shape(const ustring& key, u32 size);
+        bool same(const ustring& key, u32 size) const;
 
         template<typename T>
         bool is() const {
@@ -85,14 +94,17 @@ namespace basil {
 
     class NumericType : public Type {
         bool _floating;
+    protected:
+        virtual bool lazyImplicitly(const Type* other) const override;
+        virtual bool lazyExplicitly(const Type* other) const override;
     public:
         static const TypeClass CLASS;
 
         NumericType(u32 size, bool floating,
                     const TypeClass* tc = &CLASS);
         bool floating() const;
-        virtual bool implicitly(const Type* other) const override;
-        virtual bool explicitly(const Type* other) const override;
+        static u64 shape(u32 size, bool floating);
+        bool same(u32 size, bool floating) const;
     };
 
     const Type* unionOf(const vector<const Type*>& elements);
@@ -100,6 +112,9 @@ namespace basil {
     class ArrayType : public Type {
         const Type* _element;
         i64 _count;
+    protected:
+        virtual bool lazyImplicitly(const Type* other) const override;
+        virtual bool lazyExplicitly(const Type* other) const override;
     public:
         static const TypeClass CLASS;
 
@@ -111,8 +126,12 @@ namespace basil {
         const Type* element() const;
         i64 count() const;
         bool sized() const;
-        virtual bool implicitly(const Type* other) const override;
-        virtual bool explicitly(const Type* other) const override;
+        static u64 shape(const Type* element);
+        static u64 shape(const Type* element, u32 size);
+        static u64 shape(const vector<const Type*>& elements);
+        bool same(const Type* element) const;
+        bool same(const Type* element, u32 size) const;
+        bool same(const vector<const Type*>& elements) const;
         virtual bool wildcard() const override;
         virtual void format(stream& io) const override;
     };
@@ -120,6 +139,9 @@ namespace basil {
     class TupleType : public Type {
         vector<const Type*> _members;
         vector<u32> _offsets;
+    protected:
+        virtual bool lazyImplicitly(const Type* other) const override;
+        virtual bool lazyExplicitly(const Type* other) const override;
     public:
         static const TypeClass CLASS;
 
@@ -129,78 +151,115 @@ namespace basil {
         const Type* member(u32 i) const;
         u32 offset(u32 i) const;
         u32 count() const;
-        virtual bool implicitly(const Type* other) const override;
-        virtual bool explicitly(const Type* other) const override;
+        static u64 shape(const vector<const Type*>& members);
+        bool same(const vector<const Type*>& members) const;
         virtual void format(stream& io) const override;
     };
 
+    // Members of a union or intersection type, in an exact-size array
+    // sorted by type id. Sets with more than a handful of members also keep
+    // a bitset over type ids, so membership tests don't need to scan.
+    class TypeMembers {
+        const Type** _types;
+        u64* _bits;
+        u32 _size, _words;
+    public:
+        TypeMembers(const set<const Type*>& types);
+        ~TypeMembers();
+        TypeMembers(const TypeMembers& other) = delete;
+        TypeMembers& operator=(const TypeMembers& other) = delete;
+        u32 size() const;
+        bool has(const Type* t) const;
+        bool same(const set<const Type*>& types) const;
+        const Type* const* begin() const;
+        const Type* const* end() const;
+    };
+
     class UnionType : public Type {
-        set<const Type*> _members;
+        TypeMembers _members;
+    protected:
+        virtual bool lazyImplicitly(const Type* other) const override;
+        virtual bool lazyExplicitly(const Type* other) const override;
     public:
         static const TypeClass CLASS;
 
         UnionType(const set<const Type*>& members,
                   const TypeClass* tc = &CLASS);
-        const set<const Type*>& members() const;
+        const TypeMembers& members() const;
         bool has(const Type* t) const;
-        virtual bool implicitly(const Type* other) const override;
-        virtual bool explicitly(const Type* other) const override;
+        static u64 shape(const set<const Type*>& members);
+        bool same(const set<const Type*>& members) const;
         virtual void format(stream& io) const override;
     };
 
     class IntersectionType : public Type {
-        set<const Type*> _members;
+        TypeMembers _members;
+    protected:
+        virtual bool lazyImplicitly(const Type* other) const override;
+        virtual bool lazyExplicitly(const Type* other) const override;
     public:
         static const TypeClass CLASS;
 
         IntersectionType(const set<const Type*>& members,
                          const TypeClass* tc = &CLASS);
-        const set<const Type*>& members() const;
+        const TypeMembers& members() const;
         bool has(const Type* t) const;
+        static u64 shape(const set<const Type*>& members);
+        bool same(const set<const Type*>& members) const;
         virtual bool conflictsWith(const Type* other) const override;
-        virtual bool implicitly(const Type* other) const override;
-        virtual bool explicitly(const Type* other) const override;
         virtual void format(stream& io) const override;
     };
 
     class ReferenceType : public Type {
         const Type* _element;
+    protected:
+        virtual bool lazyImplicitly(const Type* other) const override;
+        virtual bool lazyExplicitly(const Type* other) const override;
     public:
         static const TypeClass CLASS;
 
         ReferenceType(const Type* element, const TypeClass* tc = &CLASS);
         const Type* element() const;
-        virtual bool implicitly(const Type* other) const override;
-        virtual bool explicitly(const Type* other) const override;
+        static u64 shape(const Type* element);
+        bool same(const Type* element) const;
         virtual void format(stream& io) const override;
     };
 
     class ListType : public Type {
         const Type* _element;
+    protected:
+        virtual bool lazyImplicitly(const Type* other) const override;
+        virtual bool lazyExplicitly(const Type* other) const override;
     public:
         static const TypeClass CLASS;
 
         ListType(const Type* element, const TypeClass* tc = &CLASS);
         const Type* element() const;
-        virtual bool implicitly(const Type* other) const override;
-        virtual bool explicitly(const Type* other) const override;
+        static u64 shape(const Type* element);
+        bool same(const Type* element) const;
         virtual void format(stream& io) const override;
     };
 
     class EmptyType : public Type {
+    protected:
+        virtual bool lazyImplicitly(const Type* other) const override;
+        virtual bool lazyExplicitly(const Type* other) const override;
     public:
         static const TypeClass CLASS;
 
         EmptyType(const TypeClass* tc = &CLASS);
-        virtual bool implicitly(const Type* other) const override;
-        virtual bool explicitly(const Type* other) const override;
+        static u64 shape();
+        bool same() const;
         virtual void format(stream& io) const override;
     };
 
     class FunctionType : public Type {
         const Type *_arg, *_ret;
         vector<Constraint> _cons;
-        bool _quoting;
+        bool _quoting, _defaultcons;
+    protected:
+        virtual bool lazyImplicitly(const Type* other) const override;
+        virtual bool lazyExplicitly(const Type* other) const override;
     public:
         static const TypeClass CLASS;
 
@@ -215,27 +274,52 @@ namespace basil {
         bool quoting() const;
         const vector<Constraint>& constraints() const;
         bool total() const;
+        static u64 shape(const Type* arg, const Type* ret, 
+                         bool quoting = false);
+        static u64 shape(const Type* arg, const Type* ret, 
+                         const vector<Constraint>& cons);
+        static u64 shape(const Type* arg, const Type* ret, bool quoting,
+                         const vector<Constraint>& cons);
+        bool same(const Type* arg, const Type* ret, 
+                  bool quoting = false) const;
+        bool same(const Type* arg, const Type* ret, 
+                  const vector<Constraint>& cons) const;
+        bool same(const Type* arg, const Type* ret, bool quoting,
+                  const vector<Constraint>& cons) const;
         virtual bool conflictsWith(const Type* other) const override;
-        virtual bool implicitly(const Type* other) const override;
-        virtual bool explicitly(const Type* other) const override;
         virtual void format(stream& io) const override;
-        virtual Constraint matches(Meta fr) const;
+        virtual Constraint matches(const Meta& fr) const;
     };
 
-    Constraint maxMatch(const vector<Constraint>& cons, Meta fr);
+    Constraint maxMatch(const vector<Constraint>& cons, const Meta& fr);
+
+    // Hash-consing table for types. Each type class hashes and compares
+    // its constructor arguments directly (shape() and same()), so finding 
+    // an existing type doesn't construct or format anything.
+    struct TypeSlot {
+        u64 hash;
+        const Type* type;
+    };
 
-    extern map<ustring, const Type*> typemap;
+    extern TypeSlot* typetable;
+    extern u32 typemask;
+    void internType(u64 hash, const Type* t);
 
     template<typename T, typename... Args>
-    const T* find(Args... args) {
-        T t(args...);
-        auto it = typemap.find(t.key());
-        if (it == typemap.end()) {
-            const T* ptr = new T(t);
-            typemap.insert({ t.key(), ptr });
-            return ptr;
+    const T* find(const Args&... args) {
+        u64 h = T::shape(args...) ^ (u64)&T::CLASS;
+        if (typetable) {
+            for (u32 i = h & typemask; typetable[i].type; 
+                 i = (i + 1) & typemask) {
+                const Type* t = typetable[i].type;
+                if (typetable[i].hash == h && t->typeclass() == &T::CLASS 
+                    && t->template as<T>()->same(args...)) 
+                    return t->template as<T>();
+            }
         }
-        return it->second->template as<T>();
+        const T* t = new T(args...);
+        internType(h, t);
+        return t;
     }
 
     template<typename T, typename U, typename... Args>
@@ -32,8 +32,9 @@ namespace basil {
             Value* _meta;
             builtin_t _builtin;
             Location* _loc;
-            bool _reassigned;
+            bool _reassigned, _known;
             Storage _storage;
+            static u32 _reassignments;
         public:
             Entry(const Type* type = nullptr, builtin_t builtin = nullptr);
             Entry(const Type* type, Value* meta, 
@@ -54,10 +55,55 @@ namespace basil {
             Storage& storage();
             bool reassigned() const;
             void reassign();
+            bool known() const;
+            bool& known();
+            static u32 reassignments();
+        };
+
+        // The bindings of a single scope. Most scopes hold only a few names,
+        // so they're kept in a flat array and searched linearly, with a hash
+        // index built only once the scope grows past INDEX_MIN bindings.
+        class Scope {
+            static const u32 INDEX_MIN = 8;
+            pair<ustring, Entry>* _entries;
+            u32 _size, _capacity;
+            map<ustring, u32>* _index;
+            u32 slot(const ustring& name) const;
+            void reindex();
+        public:
+            Scope();
+            ~Scope();
+            Scope(const Scope& other);
+            Scope& operator=(const Scope& other);
+            u32 size() const;
+            const Entry* find(const ustring& name) const;
+            Entry* find(const ustring& name);
+            bool has(const ustring& name) const;
+            Entry& operator[](const ustring& name);
+            void erase(const ustring& name);
+            const pair<ustring, Entry>* begin() const;
+            pair<ustring, Entry>* begin();
+            const pair<ustring, Entry>* end() const;
+            pair<ustring, Entry>* end();
         };
     
     private:
-        map<ustring, Entry>* table;
+        Scope* table;
+        vector<Stack*>* imports;
+        const Stack* imported(const ustring& name) const;
+        Stack* imported(const ustring& name);
+        bool importsDeclare(const ustring& name) const;
+        void gatherImports(vector<const Stack*>& scopes) const;
+
+        // definitions evaluated on first lookup
+        map<ustring, Term*>* deferred;
+        Source* deferredsrc;
+        void force(const ustring& name);
+
+        // instances of generic lambdas defined in this scope, shared between
+        // copies of the same lambda, by body term and argument type
+        using instkey_t = pair<const Term*, const Type*>;
+        map<instkey_t, Lambda*>* instances;
 
         // type methods
         using tmscope_t = map<pair<const Type*, const Type*>, Entry>;
@@ -93,6 +139,12 @@ namespace basil {
         Entry* operator[](const ustring& name);
         const Stack* findenv(const ustring& name) const;
         Stack* findenv(const ustring& name);
+        bool declared(const ustring& name) const;
+        const ustring* collision(const Stack& env, const Stack*& owner) const;
+        void import(Stack* env);
+        void defer(const ustring& name, Term* t);
+        Lambda* instance(const Term* body, const Type* arg) const;
+        void addInstance(const Term* body, const Type* arg, Lambda* l);
         Entry* interactOf(const Type* a, const Type* b);
         void interact(const Type* a, const Type* b, const Meta& f);
         void interact(const Type* a, const Type* b, builtin_t f);
@@ -105,10 +157,10 @@ namespace basil {
         void copy(Stack& other);
         void copy(vector<Value*>& other);
         u32 size() const;
-        const map<ustring, Entry>& scope() const;
-        map<ustring, Entry>& scope();
-        const map<ustring, Entry>& nearestScope() const;
-        map<ustring, Entry>& nearestScope();
+        const Scope& scope() const;
+        Scope& scope();
+        const Scope& nearestScope() const;
+        Scope& nearestScope();
         Stack* parent();
         const Stack* parent() const;
         u32 depth() const;
@@ -128,6 +180,7 @@ namespace basil {
         u32 _line, _column;
         const ValueClass* _valueclass;
         const Type* _cachetype;
+        mutable u32 _refs;
     protected:
         void indent(stream& io, u32 level) const;
         void setType(const Type* t);
@@ -147,9 +200,12 @@ namespace basil {
         virtual Stack::Entry* entry(Stack& ctx) const;
         virtual Location* gen(Stack& ctx, CodeGenerator& gen, CodeFrame& frame);
         virtual Value* clone(Stack& ctx) const = 0;
+        Value* share() const;
+        void release();
         virtual void repr(stream& io) const = 0;
         virtual void explore(Explorer& e);
         virtual bool pure(Stack& ctx) const;
+        virtual bool foldConstants(Stack& ctx, bool calls);
 
         template<typename T>
         bool is() const {
@@ -172,6 +228,22 @@ namespace basil {
         }
     };
 
+    // Compile-time evaluation can be given a budget of fuel, spent on
+    // calls, loop iterations and array elements; by default it's unlimited.
+    // Once it runs out, folds yield unknown values and the expression is
+    // left to runtime code, unless a type depended on it.
+    struct Exhaustion {
+        u32 line, column;
+    };
+
+    void setFuel(u64 fuel);
+    void refuel(u32 line, u32 column);
+    bool burn(u64 amount = 1);
+    bool exhausted();
+    u64 starved();
+    const vector<Exhaustion>& exhaustions();
+    void dropExhaustions(u32 count);
+
     class Builtin : public Value {
     public:
         static const ValueClass CLASS;
@@ -323,6 +395,7 @@ namespace basil {
         virtual Value* clone(Stack& ctx) const override;
         virtual void repr(stream& io) const override;
         virtual bool pure(Stack& ctx) const override;
+        virtual bool foldConstants(Stack& ctx, bool calls) override;
     };
 
     class Interaction : public Value {
@@ -357,6 +430,7 @@ namespace basil {
         virtual void repr(stream& io) const override;
         virtual void explore(Explorer& e) override;
         virtual bool pure(Stack& ctx) const override;
+        virtual bool foldConstants(Stack& ctx, bool calls) override;
     };
 
     class Program : public Value {
@@ -378,6 +452,8 @@ namespace basil {
         virtual void repr(stream& io) const override;
         virtual void explore(Explorer& e) override;
         virtual bool pure(Stack& ctx) const override;
+        virtual bool foldConstants(Stack& ctx, bool calls) override;
+        void eliminateDead(Stack& ctx);
     };
 
     class Quote : public Builtin {
@@ -397,16 +473,37 @@ namespace basil {
         virtual void repr(stream& io) const override;
     };
 
+    enum Purity : u8 {
+        PURITY_UNKNOWN, PURITY_PENDING, PURITY_PURE, PURITY_IMPURE
+    };
+
+    // Once a pure lambda has been called this many times at compile time,
+    // its results on scalar arguments are memoized. Zero disables this.
+    void setHotCalls(u32 calls);
+
+    // Upper bound on the number of lambdas cloned for constant arguments,
+    // per compilation unit. respecialize() restores it for the next unit.
+    void setSpecializations(u32 budget);
+    void respecialize();
+
     class Lambda : public Builtin {
         Stack* _ctx, *_bodyscope;
         Value *_body, *_match;
+        Term* _term;
         ustring _name;
         ustring _label;
         vector<ustring> _alts;
-        map<ustring, Stack::Entry> _captures;
+        vector<ustring> _freevars;
         map<const Type*, Lambda*> insts;
 
-        bool _inlined;
+        bool _inlined, _gathered, _closed;
+        Purity _purity;
+        u32 _puritydepth, _purityepoch;
+        u32 _calls;
+        map<Meta, Meta>* _memo;
+        map<Meta, Lambda*>* _specs;
+
+        bool closed() const;
     protected:
         virtual const Type* lazyType(Stack& ctx) override;
     public:
@@ -429,12 +526,18 @@ namespace basil {
                              const Meta& value);
         virtual Location* gen(Stack& ctx, CodeGenerator& gen, CodeFrame& frame) override;
         bool inlined() const;
+        bool pureBody();
+        bool hot();
+        const Meta* memoized(const Meta& arg) const;
+        void memoize(const Meta& arg, const Meta& result);
+        Lambda* specialize(Stack& ctx, const Meta& arg);
         Location* genInline(Stack& ctx, Location* arg, CodeGenerator& gen, CodeFrame& frame);
         const ustring& label() const;
         void addAltLabel(const ustring& label);
         virtual Value* clone(Stack& ctx) const override;
         virtual void repr(stream& io) const override;
         virtual void explore(Explorer& e) override;
+        virtual bool foldConstants(Stack& ctx, bool calls) override;
         void instantiate(const Type* t, Lambda* l);
         Lambda* instance(const Type* t);
     };
@@ -457,6 +560,7 @@ namespace basil {
              const ValueClass* vc = &CLASS);
         ~Call();
 
+        Lambda* instance() const;
         virtual void format(stream& io, u32 level = 0) const override;
         virtual Meta fold(Stack& ctx) override;
         virtual Location* gen(Stack& ctx, CodeGenerator& gen, CodeFrame& frame) override;
@@ -464,6 +568,9 @@ namespace basil {
         virtual void repr(stream& io) const override;
         virtual void explore(Explorer& e) override;
         virtual bool pure(Stack& ctx) const override;
+        virtual bool foldConstants(Stack& ctx, bool calls) override;
+    private:
+        Meta foldBody(Lambda* l);
     };
 
     class BinaryOp : public Builtin {
@@ -486,6 +593,7 @@ namespace basil {
         virtual void repr(stream& io) const override;
         virtual void explore(Explorer& e) override;
         virtual bool pure(Stack& ctx) const override;
+        virtual bool foldConstants(Stack& ctx, bool calls) override;
     };
 
     class UnaryOp : public Builtin {
@@ -506,6 +614,7 @@ namespace basil {
         virtual void repr(stream& io) const override;
         virtual void explore(Explorer& e) override;
         virtual bool pure(Stack& ctx) const override;
+        virtual bool foldConstants(Stack& ctx, bool calls) override;
     };
 
     class BinaryMath : public BinaryOp {
@@ -730,6 +839,7 @@ namespace basil {
         virtual Meta fold(Stack& ctx) override;
         virtual Value* clone(Stack& ctx) const override;
         virtual void repr(stream& io) const override;
+        virtual void explore(Explorer& e) override;
     };
 
     class Array : public Builtin {
@@ -745,12 +855,14 @@ namespace basil {
         virtual Meta fold(Stack& ctx) override;
         virtual Value* clone(Stack& ctx) const override;
         virtual void repr(stream& io) const override;
+        virtual void explore(Explorer& e) override;
         virtual bool lvalue(Stack& ctx) override;
         virtual bool pure(Stack& ctx) const override;
     };
 
     class Index : public Builtin {
         Value *arr, *idx;
+        Meta _read; // elements read from a lazy range
     public:
         static const ValueClass CLASS;
 
@@ -760,8 +872,10 @@ namespace basil {
         virtual void format(stream& io, u32 level = 0) const override;
         virtual Value* apply(Stack& ctx, Value* v) override;
         virtual Meta fold(Stack& ctx) override;
+        bool store(Stack& ctx, const Meta& value);
         virtual Value* clone(Stack& ctx) const override;
         virtual void repr(stream& io) const override;
+        virtual void explore(Explorer& e) override;
         virtual bool lvalue(Stack& ctx) override;
         virtual bool pure(Stack& ctx) const override;
     };
@@ -776,6 +890,24 @@ namespace basil {
         virtual Value* clone(Stack& ctx) const override;
     };
 
+    // Integers from first to last inclusive, as produced by '..'. Spliced 
+    // into array literals without creating a value per element.
+    class IntegerRange : public Value {
+        i64 _first;
+        u32 _count;
+    public:
+        static const ValueClass CLASS;
+
+        IntegerRange(i64 first, u32 count, u32 line, u32 column, 
+                     const ValueClass* vc = &CLASS);
+        i64 first() const;
+        u32 count() const;
+        virtual void format(stream& io, u32 level = 0) const override;
+        virtual Meta fold(Stack& ctx) override;
+        virtual Value* clone(Stack& ctx) const override;
+        virtual void repr(stream& io) const override;
+    };
+
     class Repeat : public BinaryOp {
     public:
         static const ValueClass CLASS;
@@ -805,6 +937,7 @@ namespace basil {
         virtual Value* clone(Stack& ctx) const override;
         virtual Meta fold(Stack& ctx) override;
         virtual bool lvalue(Stack& ctx) override;
+        virtual bool foldConstants(Stack& ctx, bool calls) override;
     };
 
     class Join : public BinaryOp {
@@ -824,13 +957,18 @@ namespace basil {
 
     class Intersect : public BinaryOp {
         static const Type *_BASE_TYPE;
-        map<Meta, Lambda*> _casecache;
+        vector<Lambda*> _cases;
+        map<Meta, u32> _valuecases;
+        u32 _opencase;
+        bool _flattened;
         ustring _label;
         virtual const Type* lazyType(Stack& ctx) override;
+        void flatten(Stack& ctx);
     protected:
         void populate(Stack& ctx, map<const Type*, 
                       vector<Value*>>& types);
         void getFunctions(Stack& ctx, vector<Lambda*>& functions);
+        void getCases(vector<Lambda*>& cases);
     public:
         static const Type *BASE_TYPE();
         static const ValueClass CLASS;
@@ -857,7 +995,9 @@ namespace basil {
         virtual void format(stream& io, u32 level = 0) const override;
         virtual Value* clone(Stack& ctx) const override;
         virtual void repr(stream& io) const override;
+        virtual void explore(Explorer& e) override;
         virtual bool pure(Stack& ctx) const override;
+        virtual bool foldConstants(Stack& ctx, bool calls) override;
     };
 
     class While : public Builtin {
@@ -872,8 +1012,10 @@ namespace basil {
         virtual void format(stream& io, u32 level = 0) const override;
         virtual Value* clone(Stack& ctx) const override;
         virtual void repr(stream& io) const override;
+        virtual void explore(Explorer& e) override;
         virtual Location* gen(Stack& ctx, CodeGenerator& gen, CodeFrame& frame) override;
         virtual bool pure(Stack& ctx) const override;
+        virtual bool foldConstants(Stack& ctx, bool calls) override;
     };
 
     class Define : public Builtin {
@@ -901,6 +1043,10 @@ namespace basil {
     void bind(Stack& ctx, Value* dst, Value* src);
     void assign(Stack& ctx, Value* dst, Value* src);
 
+    // Assigns src to the variable dst, given src's already folded value.
+    // Like the above, dst also takes on any builtin src refers to.
+    void assign(Stack& ctx, Value* dst, Value* src, const Meta& value);
+
     class Autodefine : public Builtin {
         Value* _name;
         Value* _init;
@@ -910,6 +1056,8 @@ namespace basil {
         Autodefine(u32 line, u32 column,
                    const ValueClass* vc = &CLASS);
         ~Autodefine();
+        Value* name() const;
+        Value* init() const;
         virtual void format(stream& io, u32 level = 0) const override;
         virtual Value* apply(Stack& ctx, Value* arg) override;
         virtual bool canApply(Stack& ctx, Value* arg) const override;
@@ -921,6 +1069,7 @@ namespace basil {
         virtual void explore(Explorer& e) override;
         virtual Meta fold(Stack& ctx) override;
         virtual bool pure(Stack& ctx) const override;
+        virtual bool foldConstants(Stack& ctx, bool calls) override;
     };
 
     class Assign : public Builtin {
@@ -940,6 +1089,7 @@ namespace basil {
         virtual void explore(Explorer& e) override;
         virtual Meta fold(Stack& ctx) override;
         virtual bool pure(Stack& ctx) const override;
+        virtual bool foldConstants(Stack& ctx, bool calls) override;
     };
 
     class Print : public UnaryOp {
@@ -982,6 +1132,7 @@ namespace basil {
         virtual void explore(Explorer& e) override;
         virtual bool lvalue(Stack& ctx) override;
         virtual bool pure(Stack& ctx) const override;
+        virtual bool foldConstants(Stack& ctx, bool calls) override;
     }; 
     
 
@@ -997,8 +1148,17 @@ namespace basil {
         virtual void repr(stream& io) const override;
     };    
     
+    // Pure top-level 'meta:' expressions, and the operands of 'meta: print',
+    // can be folded concurrently by this many forked worker processes.
+    // Results are committed in source order. Zero folds each in place.
+    void setMetaWorkers(u32 workers);
+
+    // Folds and commits any meta expressions still waiting for a worker.
+    void flushMeta();
+
     class MetaEval : public Builtin {
         Meta val;
+        bool _pending;
     public:
         static const ValueClass CLASS;
 
@@ -1010,6 +1170,7 @@ namespace basil {
         virtual void repr(stream& io) const override;
         virtual Meta fold(Stack& ctx) override;
         virtual bool pure(Stack& ctx) const override;
+        void commit(Stack& ctx, Value* v, const Meta* folded);
     };
 
     class Use : public Builtin {
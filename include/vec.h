@@ -4,6 +4,7 @@
 #include "defs.h"
 #include <new>
 #include <initializer_list>
+#include <utility>
 
 template<typename T>
 class vector {
@@ -39,7 +40,12 @@ class vector {
         u8* old = data;
         u32 oldsize = _size;
         init(_capacity * 2);
-        copy((const T*)old, oldsize);
+        T* optr = (T*)old;
+        T* tptr = (T*)data;
+        for (u32 i = 0; i < oldsize; i ++) {
+            new(tptr + i) T(std::move(optr[i]));
+            ++ _size;
+        }
         free(old);
     }
 
@@ -76,6 +82,13 @@ public:
         new(tptr + _size) T(t);
         ++ _size;
     }
+
+    void push(T&& t) {
+        while (_size + 1 >= _capacity) grow();
+        T* tptr = (T*)data;
+        new(tptr + _size) T(std::move(t));
+        ++ _size;
+    }
     
     void pop() {
         -- _size;
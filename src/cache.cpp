@@ -0,0 +1,260 @@
+#include "cache.h"
+#include "source.h"
+#include "term.h"
+#include "hash.h"
+#include <cstdio>
+
+namespace basil {
+    static const u8 CACHE_MAGIC[4] = { 'b', 'l', 'c', 1 };
+
+    // Bump whenever the encoding or the shape of parsed terms changes, so
+    // caches written by older compilers are rejected.
+    static const u32 CACHE_VERSION = 3;
+
+    enum CacheTag : u8 {
+        CACHE_INT, CACHE_RATIONAL, CACHE_STRING, CACHE_CHAR, CACHE_BOOL,
+        CACHE_VOID, CACHE_EMPTY, CACHE_VARIABLE, CACHE_BLOCK
+    };
+
+    string cachePath(const char* path) {
+        // appended byte by byte: string's const char* append also counts
+        // the terminator, which would leave the path ending at the source
+        string s;
+        for (const char* p = path; *p; ++ p) s += *p;
+        s += 'c';
+        return s;
+    }
+
+    // Collects the paths named by 'use "<path>"' in a source. This scans
+    // the text rather than parsing it, so a use written any other way
+    // isn't tracked.
+    static void usedPaths(const Source& src, vector<string>& paths) {
+        for (u32 i = 0; i < src.size(); i ++) {
+            const ustring& line = src.line(i);
+            for (u32 j = 0; j + 3 < line.size(); j ++) {
+                if (line[j] == '#') break;
+                if (line[j] != 'u' || line[j + 1] != 's' || line[j + 2] != 'e')
+                    continue;
+                if (j > 0 && !isspace(line[j - 1]) && line[j - 1] != '(')
+                    continue;
+                u32 k = j + 3;
+                if (!isspace(line[k])) continue;
+                while (k < line.size() && isspace(line[k])) k ++;
+                if (k >= line.size() || line[k] != '"') continue;
+                string path;
+                for (k ++; k < line.size() && line[k] != '"'; k ++) {
+                    uchar c = line[k];
+                    for (u32 b = 0; b < c.size(); b ++) path += c[b];
+                }
+                paths.push(path);
+                j = k;
+            }
+        }
+    }
+
+    static u64 moduleKey(const Source& src, set<string>& seen) {
+        u64 h = CACHE_VERSION;
+        for (u32 i = 0; i < src.size(); i ++) {
+            h = rotl(h, 7) ^ hash(src.line(i));
+        }
+
+        // a module's entry is stale once anything it uses changes, not
+        // just its own text
+        vector<string> paths;
+        usedPaths(src, paths);
+        for (const string& path : paths) {
+            if (seen.find(path) != seen.end()) continue;
+            seen.insert(path);
+            if (!exists((const char*)path.raw())) continue;
+            Source dep((const char*)path.raw());
+            h = rotl(h, 13) ^ moduleKey(dep, seen);
+        }
+        return h;
+    }
+
+    u64 sourceKey(const Source& src) {
+        set<string> seen;
+        return moduleKey(src, seen);
+    }
+
+    // Writer
+
+    static void writeRaw(vector<u8>& out, const void* data, u32 size) {
+        const u8* bytes = (const u8*)data;
+        for (u32 i = 0; i < size; i ++) out.push(bytes[i]);
+    }
+
+    template<typename T>
+    static void writeWord(vector<u8>& out, const T& t) {
+        writeRaw(out, &t, sizeof(T));
+    }
+
+    static void writeUString(vector<u8>& out, const ustring& s) {
+        writeWord<u32>(out, s.size());
+        for (u32 i = 0; i < s.size(); i ++) writeWord(out, s[i]);
+    }
+
+    static void writeTerm(vector<u8>& out, const Term* t) {
+        u8 tag;
+        if (t->is<IntegerTerm>()) tag = CACHE_INT;
+        else if (t->is<RationalTerm>()) tag = CACHE_RATIONAL;
+        else if (t->is<StringTerm>()) tag = CACHE_STRING;
+        else if (t->is<CharTerm>()) tag = CACHE_CHAR;
+        else if (t->is<BoolTerm>()) tag = CACHE_BOOL;
+        else if (t->is<VoidTerm>()) tag = CACHE_VOID;
+        else if (t->is<EmptyTerm>()) tag = CACHE_EMPTY;
+        else if (t->is<VariableTerm>()) tag = CACHE_VARIABLE;
+        else tag = CACHE_BLOCK;
+
+        writeWord(out, tag);
+        writeWord(out, t->line());
+        writeWord(out, t->column());
+        switch (tag) {
+            case CACHE_INT:
+                writeWord(out, t->as<IntegerTerm>()->value());
+                break;
+            case CACHE_RATIONAL:
+                writeWord(out, t->as<RationalTerm>()->value());
+                break;
+            case CACHE_STRING:
+                writeUString(out, t->as<StringTerm>()->value());
+                break;
+            case CACHE_CHAR:
+                writeWord(out, t->as<CharTerm>()->value());
+                break;
+            case CACHE_BOOL:
+                writeWord<u8>(out, t->as<BoolTerm>()->value());
+                break;
+            case CACHE_VARIABLE:
+                writeUString(out, t->as<VariableTerm>()->name());
+                break;
+            case CACHE_BLOCK: {
+                const vector<Term*>& children =
+                    t->as<BlockTerm>()->children();
+                writeWord<u32>(out, children.size());
+                for (const Term* child : children) writeTerm(out, child);
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    void cacheModule(const char* path, const Source& src,
+                     const ProgramTerm* body) {
+        vector<u8> out;
+        writeRaw(out, CACHE_MAGIC, 4);
+        writeWord(out, sourceKey(src));
+        writeWord(out, body->line());
+        writeWord(out, body->column());
+        writeWord<u32>(out, body->children().size());
+        for (const Term* t : body->children()) writeTerm(out, t);
+
+        FILE* f = fopen((const char*)cachePath(path).raw(), "wb");
+        if (!f) return; // caching is best-effort
+        fwrite(&out[0], 1, out.size(), f);
+        fclose(f);
+    }
+
+    // Reader
+
+    struct CacheReader {
+        const u8* pos;
+        const u8* end;
+        bool failed;
+
+        bool readRaw(void* data, u32 size) {
+            if (failed || (u64)(end - pos) < size) return !(failed = true);
+            u8* bytes = (u8*)data;
+            for (u32 i = 0; i < size; i ++) bytes[i] = *pos ++;
+            return true;
+        }
+
+        template<typename T>
+        T read() {
+            T t = T();
+            readRaw(&t, sizeof(T));
+            return t;
+        }
+
+        ustring readUString() {
+            ustring s;
+            u32 size = read<u32>();
+            for (u32 i = 0; i < size && !failed; i ++) s += read<uchar>();
+            return s;
+        }
+
+        Term* readTerm() {
+            u8 tag = read<u8>();
+            u32 line = read<u32>(), column = read<u32>();
+            if (failed) return nullptr;
+            switch (tag) {
+                case CACHE_INT:
+                    return new IntegerTerm(read<i64>(), line, column);
+                case CACHE_RATIONAL:
+                    return new RationalTerm(read<double>(), line, column);
+                case CACHE_STRING:
+                    return new StringTerm(readUString(), line, column);
+                case CACHE_CHAR:
+                    return new CharTerm(read<uchar>(), line, column);
+                case CACHE_BOOL:
+                    return new BoolTerm(read<u8>(), line, column);
+                case CACHE_VOID:
+                    return new VoidTerm(line, column);
+                case CACHE_EMPTY:
+                    return new EmptyTerm(line, column);
+                case CACHE_VARIABLE:
+                    return new VariableTerm(readUString(), line, column);
+                case CACHE_BLOCK: {
+                    BlockTerm* b = new BlockTerm({}, line, column);
+                    u32 size = read<u32>();
+                    for (u32 i = 0; i < size && !failed; i ++) {
+                        Term* child = readTerm();
+                        if (child) b->add(child);
+                    }
+                    return b;
+                }
+                default:
+                    failed = true;
+                    return nullptr;
+            }
+        }
+    };
+
+    ProgramTerm* loadCachedModule(const char* path, const Source& src) {
+        FILE* f = fopen((const char*)cachePath(path).raw(), "rb");
+        if (!f) return nullptr;
+        fseek(f, 0, SEEK_END);
+        long size = ftell(f);
+        fseek(f, 0, SEEK_SET);
+        if (size < 4 + (long)sizeof(u64)) {
+            fclose(f);
+            return nullptr;
+        }
+        u8* data = new u8[size];
+        bool complete = fread(data, 1, size, f) == (unsigned long)size;
+        fclose(f);
+
+        CacheReader r = { data, data + size, !complete };
+        u8 magic[4];
+        r.readRaw(magic, 4);
+        for (u32 i = 0; i < 4; i ++) if (magic[i] != CACHE_MAGIC[i]) {
+            r.failed = true;
+        }
+        if (r.read<u64>() != sourceKey(src)) r.failed = true;
+
+        ProgramTerm* p = nullptr;
+        if (!r.failed) {
+            u32 line = r.read<u32>(), column = r.read<u32>();
+            p = new ProgramTerm({}, line, column);
+            u32 n = r.read<u32>();
+            for (u32 i = 0; i < n && !r.failed; i ++) {
+                Term* t = r.readTerm();
+                if (t) p->add(t);
+            }
+            if (r.failed || r.pos != r.end) delete p, p = nullptr;
+        }
+        delete[] data;
+        return p;
+    }
+}
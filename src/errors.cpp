@@ -2,11 +2,39 @@
 #include "source.h"
 
 namespace basil {
-    Error::Error(): src(nullptr), line(0), column(0) {
+    DeferredMessage::DeferredMessage(): next(nullptr) {
         //
     }
 
+    DeferredMessage::~DeferredMessage() {
+        //
+    }
+
+    Error::Error(): src(nullptr), line(0), column(0), deferred(nullptr) {
+        //
+    }
+
+    void Error::resolve() {
+        for (DeferredMessage* m = deferred; m; m = m->next) m->format(message);
+        discard();
+    }
+
+    void Error::discard() {
+        while (deferred) {
+            DeferredMessage* next = deferred->next;
+            delete deferred;
+            deferred = next;
+        }
+    }
+
     void Error::format(stream& io) const {
+        if (deferred) {
+            Error copy = *this;
+            copy.deferred = nullptr;
+            for (DeferredMessage* m = deferred; m; m = m->next) 
+                m->format(copy.message);
+            return copy.format(io);
+        }
         println(io, message);
         if (src) {
             print(io, "    ", src->line(line - 1));
@@ -22,6 +50,10 @@ namespace basil {
     static vector<vector<Error>> errorFrames;
     static vector<set<ustring>> frameMessages;
 
+    bool catchingErrors() {
+        return errorFrames.size() > 0;
+    }
+
     void catchErrors() {
         errorFrames.push({});
         frameMessages.push({});
@@ -36,6 +68,7 @@ namespace basil {
 
     void discardErrors() {
         // if (countErrors()) printErrors(_stdout);
+        for (Error& e : errorFrames.back()) e.discard();
         errorFrames.pop();
         frameMessages.pop();
     }
@@ -67,16 +100,25 @@ namespace basil {
     }
 
     void reportError(const Error& error) {
-        ustring s;
-        buffer b = error.message;
-        fread(b, s);
         vector<Error>& es = errorFrames.size() 
             ? errorFrames.back() : errors;
+        if (error.deferred && errorFrames.size()) {
+            // duplicates are only filtered once the message is formatted
+            es.push(error);
+            if (!es.back().src && _src) es.back().src = _src;
+            return;
+        }
+        Error resolved = error;
+        if (resolved.deferred) resolved.resolve();
+
+        ustring s;
+        buffer b = resolved.message;
+        fread(b, s);
         set<ustring>& ms = frameMessages.size() 
             ? frameMessages.back() : messages;
         if (ms.find(s) == ms.end()) {
             ms.insert(s);
-            es.push(error);
+            es.push(resolved);
             if (!es.back().src && _src) es.back().src = _src;
         }
     }
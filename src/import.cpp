@@ -4,6 +4,7 @@
 #include "parse.h"
 #include "errors.h"
 #include "value.h"
+#include "cache.h"
 
 namespace basil {
     map<string, Module*> modules;
@@ -20,16 +21,20 @@ namespace basil {
     }
 
     void Module::useIn(Stack& ctx, u32 line, u32 column) {
-        for (auto& p : _body->scope().scope()) {
-            auto it = ctx.nearestScope().find(p.first);
-            if (it != ctx.nearestScope().end()) {
+        const Stack* owner = nullptr;
+        if (const ustring* name = ctx.collision(_body->scope(), owner)) {
+            for (auto& p : modules) if (&p.second->_body->scope() == owner) {
                 err(PHASE_TYPE, line, column,
                     "Module '", _path, "' redefines variable '",
-                    p.first, "' from the local environment.");
+                    *name, "' from module '", p.first, "'.");
                 return;
             }
-            ctx.nearestScope().put(p.first, p.second);
+            err(PHASE_TYPE, line, column,
+                "Module '", _path, "' redefines variable '",
+                *name, "' from the local environment.");
+            return;
         }
+        ctx.import(&_body->scope());
     }
 
     void freeModules() {
@@ -51,22 +56,26 @@ namespace basil {
         Source* src = new Source(path);
         Source* prev = currentSource();
         useSource(src);
-        TokenCache tok = lex(*src);
-        if (countErrors()) {
-            printErrors(_stdout);
-            delete src;
-            return nullptr;
-        }
-        TokenCache::View v = tok.view();
-        ProgramTerm* module = parseFull(v);
-        if (countErrors()) {
-            printErrors(_stdout);
-            delete src;
-            delete module;
-            return nullptr;
+        ProgramTerm* module = loadCachedModule(path, *src);
+        if (!module) {
+            TokenCache tok = lex(*src);
+            if (countErrors()) {
+                printErrors(_stdout);
+                delete src;
+                return nullptr;
+            }
+            TokenCache::View v = tok.view();
+            module = parseFull(v);
+            if (countErrors()) {
+                printErrors(_stdout);
+                delete src;
+                delete module;
+                return nullptr;
+            }
+            cacheModule(path, *src, module);
         }
         Stack* env = new Stack(nullptr);
-        module->eval(*env);
+        module->evalLazily(*env);
         if (countErrors()) {
             printErrors(_stdout);
             delete src;
@@ -150,9 +150,10 @@ const u8* buffer::end() const {
 }
 
 
-file _stdin_file(stdin), _stdout_file(stdout);
+file _stdin_file(stdin), _stdout_file(stdout), _stderr_file(stderr);
 
-stream &_stdin = _stdin_file, &_stdout = _stdout_file;
+stream &_stdin = _stdin_file, &_stdout = _stdout_file, 
+    &_stderr = _stderr_file;
 
 static u32 precision = 5;
 
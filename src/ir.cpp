@@ -317,7 +317,7 @@ namespace basil {
     }
     
     void postAllocationPass(CodeFrame& frame, vector<Insn*>& insns) {
-        for (Insn* i : insns) if (i->is<CallInsn>()) {
+        for (Insn* i : insns) if (i->is<CallInsn>() || i->is<CCallInsn>()) {
             vector<Location*> saved;
             for (Location* l : i->inset()) if (l->segm == REGISTER) {
                 if (i->outset().find(l) != i->outset().end()) saved.push(l);
@@ -339,7 +339,7 @@ namespace basil {
 
     void Function::reserveBackups(u32 n) {
         for (u32 i = 0; i < n; i ++) 
-            backups.push(new Location(STACK, slot(I64), I64));
+            backups.push(new Location(STACK, -i64(slot(I64)), I64));
     }
 
     Location* Function::stack(const Type* type) {
@@ -455,7 +455,7 @@ namespace basil {
 
     void CodeGenerator::reserveBackups(u32 n) {
         for (u32 i = 0; i < n; i ++) 
-            backups.push(new Location(STACK, slot(I64), I64));
+            backups.push(new Location(STACK, -i64(slot(I64)), I64));
     }
 
     Location* CodeGenerator::stack(const Type* type) {
@@ -1483,12 +1483,15 @@ namespace basil {
         x64::printer::jmp(text, data, "_memreturn");
     }
 
-    void Function::emitX86(buffer& text, buffer& data) {
+    void Function::emitX86Labels(buffer& text, buffer& data) {
         x64::printer::label(text, data, x64::TEXT, _label, false);
+        for (u32 i = 0; i < insns.size() && insns[i]->is<Label>(); i ++) 
+            insns[i]->emitX86(text, data);
+    }
 
+    void Function::emitX86Body(buffer& text, buffer& data) {
         u32 i = 0;
-        for (; i < insns.size() && insns[i]->is<Label>(); i ++) 
-            insns[i]->emitX86(text, data);
+        while (i < insns.size() && insns[i]->is<Label>()) i ++;
 
         Location rbp(RBP, I64);
         Location rsp(RSP, I64);
@@ -1507,6 +1510,60 @@ namespace basil {
         else retWord(text, data, needsStack() || size() > 0);
     }
 
+    void Function::emitX86(buffer& text, buffer& data) {
+        emitX86Labels(text, data);
+        emitX86Body(text, data);
+    }
+
+    static string toString(const ustring& s) {
+        buffer b;
+        fprint(b, s);
+        string r;
+        for (u8 c : b) r += c;
+        return r;
+    }
+
+    static bool isLabelChar(u8 c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+            || (c >= '0' && c <= '9') || c == '_' || c == '.';
+    }
+
+    // Emitted body with this function's own labels numbered in order of
+    // appearance, so that two functions compare equal iff they do the 
+    // same thing.
+    string Function::canonicalX86(const buffer& body) const {
+        set<string> own;
+        own.insert(toString(_end));
+        for (auto& p : labels) own.insert(toString(p.first));
+        map<string, u32> seen;
+        seen.put(toString(_label), 0);
+
+        string result, token;
+        for (u8 c : body) {
+            if (isLabelChar(c)) {
+                token += c;
+                continue;
+            }
+            if (token.size()) {
+                auto it = seen.find(token);
+                if (it == seen.end() && own.find(token) != own.end()) {
+                    seen.put(token, seen.size());
+                    it = seen.find(token);
+                }
+                if (it != seen.end()) {
+                    buffer b;
+                    fprint(b, "#", it->second);
+                    for (u8 d : b) result += d;
+                }
+                else for (u32 i = 0; i < token.size(); i ++) result += token[i];
+                token = string();
+            }
+            result += c;
+        }
+        for (u32 i = 0; i < token.size(); i ++) result += token[i];
+        return result;
+    }
+
     void prelude(buffer& text, buffer& data) {
         Location rax(RAX, I64);
         Location rdx(RDX, I64);
@@ -1567,7 +1624,28 @@ namespace basil {
         for (Data* d : datasrcs) d->emitX86Const(text, data);
         x64::printer::text(text, data);
         prelude(text, data);
-        for (Function* f : functions) f->emitX86(text, data);
+
+        // functions that assemble to the same code, like instances of a
+        // generic lambda that never touch their argument, are emitted once
+        // under every label
+        vector<buffer> heads, bodies;
+        map<string, u32> emitted;
+        for (Function* f : functions) {
+            buffer head, body;
+            f->emitX86Labels(head, data);
+            f->emitX86Body(body, data);
+            string key = f->canonicalX86(body);
+            auto it = emitted.find(key);
+            if (it != emitted.end()) {
+                fprint(heads[it->second], head);
+                continue;
+            }
+            emitted.put(key, heads.size());
+            heads.push(head);
+            bodies.push(body);
+        }
+        for (u32 i = 0; i < heads.size(); i ++) 
+            fprint(text, heads[i], bodies[i]);
         x64::printer::label(text, data, x64::TEXT, "start", true);
         x64::printer::label(text, data, x64::TEXT, "_start", true);
         x64::printer::label(text, data, x64::TEXT, "_main", true);
@@ -8,6 +8,7 @@
 #include "lex.h"
 #include "parse.h"
 #include "type.h"
+#include "meta.h"
 #include "term.h"
 #include "value.h"
 #include "ir.h"
@@ -22,6 +23,10 @@ u32 LEX = 1,
 
 bool interactive = true;
 bool silent = false;
+#ifdef BASIL_STATS
+bool stats = false;
+#endif
+bool foldcalls = false;
 u32 level = ASM;
 Source* src = nullptr;
 ustring outfile;
@@ -82,6 +87,7 @@ void repl() {
         program->add(t);
         program->evalChild(*s, t);
         for (Value* v : *s) {
+            refuel(v->line(), v->column());
             Meta m = v->fold(program->scope());
             if (m && !m.isVoid() && !v->is<Print>())
                 println(_stdout, m);
@@ -100,6 +106,8 @@ void repl() {
 
         if (level < IR) continue;
 
+        respecialize();
+        for (Value* v : *s) v->foldConstants(program->scope(), foldcalls);
         for (Value* v : *s) v->gen(program->scope(), gen, gen);
         gen.finalize(gen);
         
@@ -132,6 +140,42 @@ int parseArgs(int argc, char** argv) {
         else if (string(*argv) == "-silent") {
             silent = true;
         }
+#ifdef BASIL_STATS
+        else if (string(*argv) == "-stats") {
+            stats = true;
+        }
+#endif
+        else if (string(*argv) == "-fold-calls") {
+            foldcalls = true;
+        }
+        else if (string(*argv) == "-fuel") {
+            if (argc == 1) {
+                println("Error: '-fuel' was provided without an argument.");
+                return 1;
+            }
+            setFuel(strtoull(*(--argc, ++argv), nullptr, 10));
+        }
+        else if (string(*argv) == "-hot-calls") {
+            if (argc == 1) {
+                println("Error: '-hot-calls' was provided without an argument.");
+                return 1;
+            }
+            setHotCalls(strtoul(*(--argc, ++argv), nullptr, 10));
+        }
+        else if (string(*argv) == "-meta-workers") {
+            if (argc == 1) {
+                println("Error: '-meta-workers' was provided without an argument.");
+                return 1;
+            }
+            setMetaWorkers(strtoul(*(--argc, ++argv), nullptr, 10));
+        }
+        else if (string(*argv) == "-specialize") {
+            if (argc == 1) {
+                println("Error: '-specialize' was provided without an argument.");
+                return 1;
+            }
+            setSpecializations(strtoul(*(--argc, ++argv), nullptr, 10));
+        }
         else if (string(*argv) == "-ir") {
             level = IR;
         }
@@ -210,6 +254,11 @@ int main(int argc, char** argv) {
     }
     
     if (level >= IR) {
+        respecialize();
+        for (Value* v : s) v->foldConstants(program->scope(), foldcalls);
+        for (Value* v : s) {
+            if (v->is<Program>()) v->as<Program>()->eliminateDead(program->scope());
+        }
         for (Value* v : s) v->gen(program->scope(), gen, gen);
         gen.finalize(gen);
         
@@ -224,6 +273,18 @@ int main(int argc, char** argv) {
         }
     }
     
+    for (const Exhaustion& e : exhaustions()) {
+        println(_stderr, "(", e.line, ":", e.column, ") Compile-time ",
+                "evaluation ran out of fuel; compiled to runtime code.");
+    }
+
+#ifdef BASIL_STATS
+    if (stats) {
+        println(_stdout, "# meta: ", Meta::copies, " copies, ", 
+                MetaRC::incs, " incs, ", MetaRC::decs, " decs");
+    }
+#endif
+    
     delete src;
     return countErrors();
 }
@@ -5,85 +5,107 @@
 #include "value.h"
 
 namespace basil {
-    map<u64, ustring> symbolnames;
-    map<ustring, u64> symbolids;
-    u64 next = 0;
+    // Symbol names, indexed by id. Ids are handed out sequentially.
+    static vector<ustring> symbolnames;
+
+    // Open-addressed table from name to id. Each slot keeps the name's 
+    // hash, so a lookup only compares names when the hashes match.
+    struct SymbolSlot {
+        u64 hash;
+        u64 id; // id + 1, or 0 if the slot is empty
+    };
+    static SymbolSlot* symboltable = nullptr;
+    static u32 symbolmask = 0;
+
+    static void growSymbols() {
+        SymbolSlot* old = symboltable;
+        u32 oldsize = symbolmask + 1;
+        symbolmask = old ? symbolmask * 2 + 1 : 63;
+        symboltable = new SymbolSlot[symbolmask + 1];
+        for (u32 i = 0; i <= symbolmask; i ++) symboltable[i] = { 0, 0 };
+        if (!old) return;
+        for (u32 i = 0; i < oldsize; i ++) if (old[i].id) {
+            u32 j = old[i].hash & symbolmask;
+            while (symboltable[j].id) j = (j + 1) & symbolmask;
+            symboltable[j] = old[i];
+        }
+        delete[] old;
+    }
 
     u64 findSymbol(const ustring& name) {
-        auto it = symbolids.find(name);
-        if (it == symbolids.end()) {
-            u64 id = next ++;
-            symbolnames[symbolids[name] = id] = name;
-            return id;
+        if (!symboltable || (symbolnames.size() + 1) * 2 > symbolmask + 1) 
+            growSymbols();
+        u64 h = ::hash(name);
+        u32 i = h & symbolmask;
+        while (symboltable[i].id) {
+            const SymbolSlot& slot = symboltable[i];
+            if (slot.hash == h && symbolnames[slot.id - 1] == name) 
+                return slot.id - 1;
+            i = (i + 1) & symbolmask;
         }
-        return it->second;
+        symbolnames.push(name);
+        symboltable[i] = { h, symbolnames.size() };
+        return symbolnames.size() - 1;
     }
 
     const ustring& findSymbol(u64 id) {
-        auto it = symbolnames.find(id);
-        if (it == symbolnames.end()) {
-            return "";
-        }
-        return it->second;
+        static const ustring none;
+        if (id >= symbolnames.size()) return none;
+        return symbolnames[id];
     }
 
     // Meta
 
+    static MetaKind kindOf(const Type* t) {
+        if (!t) return META_NONE;
+        if (t == VOID) return META_VOID;
+        if (t->is<NumericType>()) 
+            return t->as<NumericType>()->floating() ? META_FLOAT : META_INT;
+        if (t == TYPE) return META_TYPE;
+        if (t == BOOL) return META_BOOL;
+        if (t == SYMBOL) return META_SYMBOL;
+        if (t->is<ReferenceType>()) return META_REF;
+        if (t == STRING) return META_STRING;
+        if (t->is<ListType>()) return META_LIST;
+        if (t->is<TupleType>()) return META_TUPLE;
+        if (t->is<ArrayType>()) return META_ARRAY;
+        if (t->is<UnionType>()) return META_UNION;
+        if (t->is<IntersectionType>()) return META_INTERSECT;
+        if (t->is<FunctionType>()) return META_FUNCTION;
+        return META_OTHER;
+    }
+
     void Meta::free() {
-        if (isList()) value.l->dec();
-        else if (isString()) value.s->dec();
-        else if (isArray()) value.a->dec();
-        else if (isTuple()) value.tu->dec();
-        else if (isUnion()) value.un->dec();
-        else if (isIntersect()) value.in->dec();
-        else if (isFunction()) value.f->dec();
+        if (_kind >= META_STRING && value.rc) value.rc->dec();
     }
 
+#ifdef BASIL_STATS
+    u64 Meta::copies = 0;
+#endif
+
     void Meta::copy(const Meta& other) {
+#ifdef BASIL_STATS
+        copies ++;
+#endif
         _type = other._type;
-        if (!_type || isVoid()) return;
-        else if (isInt()) value.i = other.value.i;
-        else if (isFloat()) value.d = other.value.d;
-        else if (isType()) value.t = other.value.t;
-        else if (isBool()) value.b = other.value.b;
-        else if (isSymbol()) value.i = other.value.i;
-        else if (isRef()) value.r = other.value.r;
-        else if (isString()) value.s = other.value.s, value.s->inc();
-        else if (isList()) value.l = other.value.l, value.l->inc();
-        else if (isTuple()) value.tu = other.value.tu, value.tu->inc();
-        else if (isArray()) value.a = other.value.a, value.a->inc();
-        else if (isUnion()) value.un = other.value.un, value.un->inc();
-        else if (isIntersect()) value.in = other.value.in, value.in->inc();
-        else if (isFunction()) value.f = other.value.f, value.f->inc();
+        _kind = other._kind;
+        value = other.value;
+        if (_kind >= META_STRING && value.rc) value.rc->inc();
     }
 
     void Meta::assign(const Meta& other) {
-        if (!_type) return copy(other);
         auto prev = value;
-        _type = other._type;
-        value.s = nullptr;
-        if (!_type || isVoid()) return;
-        else if (isInt()) value.i = other.value.i;
-        else if (isFloat()) value.d = other.value.d;
-        else if (isType()) value.t = other.value.t;
-        else if (isBool()) value.b = other.value.b;
-        else if (isSymbol()) value.i = other.value.i;
-        else if (isRef()) value.r = other.value.r;
-        else if (isString()) value.s = other.value.s, value.s->inc(), prev.s ? prev.s->dec() : void();
-        else if (isList()) value.l = other.value.l, value.l->inc(), prev.l ? prev.l->dec() : void();
-        else if (isTuple()) value.tu = other.value.tu, value.tu->inc(), prev.tu ? prev.tu->dec() : void();
-        else if (isArray()) value.a = other.value.a, value.a->inc(), prev.a ? prev.a->dec() : void();
-        else if (isUnion()) value.un = other.value.un, value.un->inc(), prev.un ? prev.un->dec() : void();
-        else if (isIntersect()) value.in = other.value.in, value.in->inc(), prev.in ? prev.in->dec() : void();
-        else if (isFunction()) value.f = other.value.f, value.f->inc(), prev.f ? prev.f->dec() : void();
-    }
-
-    Meta::Meta(): _type(nullptr) {
-        //
+        MetaKind prevkind = _kind;
+        copy(other);
+        if (prevkind >= META_STRING && prev.rc) prev.rc->dec();
     }
 
-    Meta::Meta(const Type* type): _type(type) {
-        //
+    Meta::Meta(): _type(nullptr), _kind(META_NONE) {
+        value.i = 0;
+    }
+
+    Meta::Meta(const Type* type): _type(type), _kind(kindOf(type)) {
+        value.i = 0;
     }
 
     Meta::Meta(const Type* type, i64 i): Meta(type) {
@@ -107,9 +129,9 @@ namespace basil {
     }
 
     Meta::Meta(const Type* type, const ustring& s): Meta(type) {
-        if (type == STRING)
+        if (_kind == META_STRING)
             value.s = new MetaString(s);
-        else if (type == SYMBOL)
+        else if (_kind == META_SYMBOL)
             value.i = findSymbol(s);
     }
 
@@ -145,6 +167,11 @@ namespace basil {
         copy(other);
     }
 
+    Meta::Meta(Meta&& other): 
+        _type(other._type), _kind(other._kind), value(other.value) {
+        other._type = nullptr, other._kind = META_NONE;
+    }
+
     Meta& Meta::operator=(const Meta& other) {
         if (this != &other) {
             assign(other);
@@ -152,18 +179,29 @@ namespace basil {
         return *this;
     }
 
+    Meta& Meta::operator=(Meta&& other) {
+        if (this != &other) {
+            Meta prev(std::move(*this));
+            _type = other._type, _kind = other._kind, value = other.value;
+            other._type = nullptr, other._kind = META_NONE;
+        }
+        return *this;
+    }
+
     const Type* Meta::type() const {
         return _type;
     }
 
+    MetaKind Meta::kind() const {
+        return _kind;
+    }
+
     bool Meta::isVoid() const {
-        return _type == VOID;
+        return _kind == META_VOID;
     }
 
     bool Meta::isInt() const {
-        if (!_type) return false;
-        return _type->is<NumericType>() 
-            && !_type->as<NumericType>()->floating();
+        return _kind == META_INT;
     }
 
     i64 Meta::asInt() const {
@@ -175,9 +213,7 @@ namespace basil {
     }
 
     bool Meta::isFloat() const {
-        if (!_type) return false;
-        return _type->is<NumericType>() 
-            && _type->as<NumericType>()->floating();
+        return _kind == META_FLOAT;
     }
 
     double Meta::asFloat() const {
@@ -189,7 +225,7 @@ namespace basil {
     }
 
     bool Meta::isType() const {
-        return _type == TYPE;
+        return _kind == META_TYPE;
     }
 
     const Type* Meta::asType() const {
@@ -201,7 +237,7 @@ namespace basil {
     }
 
     bool Meta::isBool() const {
-        return _type == BOOL;
+        return _kind == META_BOOL;
     }
 
     bool Meta::asBool() const {
@@ -213,7 +249,7 @@ namespace basil {
     }
 
     bool Meta::isSymbol() const {
-        return _type == SYMBOL;
+        return _kind == META_SYMBOL;
     }
 
     i64 Meta::asSymbol() const {
@@ -225,8 +261,7 @@ namespace basil {
     }
 
     bool Meta::isRef() const {
-        if (!_type) return false;
-        return _type->is<ReferenceType>();
+        return _kind == META_REF;
     }
 
     const Meta& Meta::asRef() const {
@@ -238,7 +273,7 @@ namespace basil {
     }
 
     bool Meta::isString() const {
-        return _type == STRING;
+        return _kind == META_STRING;
     }
 
     const ustring& Meta::asString() const {
@@ -250,8 +285,7 @@ namespace basil {
     }
 
     bool Meta::isList() const {
-        if (!_type) return false;
-        return _type->is<ListType>();
+        return _kind == META_LIST;
     }
 
     const MetaList& Meta::asList() const {
@@ -263,8 +297,7 @@ namespace basil {
     }
 
     bool Meta::isTuple() const {
-        if (!_type) return false;
-        return _type->is<TupleType>();
+        return _kind == META_TUPLE;
     }
 
     const MetaTuple& Meta::asTuple() const {
@@ -276,8 +309,7 @@ namespace basil {
     }
 
     bool Meta::isArray() const {
-        if (!_type) return false;
-        return _type->is<ArrayType>();
+        return _kind == META_ARRAY;
     }
 
     const MetaArray& Meta::asArray() const {
@@ -289,8 +321,7 @@ namespace basil {
     }
 
     bool Meta::isUnion() const {
-        if (!_type) return false;
-        return _type->is<UnionType>();
+        return _kind == META_UNION;
     }
 
     const MetaUnion& Meta::asUnion() const {
@@ -302,8 +333,7 @@ namespace basil {
     }
 
     bool Meta::isIntersect() const {
-        if (!_type) return false;
-        return _type->is<IntersectionType>();
+        return _kind == META_INTERSECT;
     }
 
     const MetaIntersect& Meta::asIntersect() const {
@@ -315,8 +345,7 @@ namespace basil {
     }
 
     bool Meta::isFunction() const {
-        if (!_type) return false;
-        return _type->is<FunctionType>();
+        return _kind == META_FUNCTION;
     }
 
     const MetaFunction& Meta::asFunction() const {
@@ -332,13 +361,7 @@ namespace basil {
     }
 
     Meta Meta::clone() const {
-        if (isList()) return value.l->clone(*this);
-        else if (isString()) return value.s->clone(*this);
-        else if (isArray()) return value.a->clone(*this);
-        else if (isTuple()) return value.tu->clone(*this);
-        else if (isUnion()) return value.un->clone(*this);
-        else if (isIntersect()) return value.in->clone(*this);
-        else if (isFunction()) return value.f->clone(*this);
+        if (_kind >= META_STRING) return value.rc->clone(*this);
         return *this;
     }
 
@@ -363,8 +386,9 @@ namespace basil {
         }
         else if (isArray()) {
             print(io, "[");
-            for (u32 i = 0; i < asArray().size(); i ++) {
-                print(io, i != 0 ? " " : "", asArray()[i]);
+            u32 i = 0;
+            for (const Meta& m : asArray()) {
+                print(io, i ++ != 0 ? " " : "", m);
             }
             print(io, "]");
         }
@@ -438,8 +462,8 @@ namespace basil {
             return h;
         }
         else if (isArray()) {
-            for (u32 i = 0; i < asArray().size(); i ++) {
-                h ^= asArray()[i].hash();
+            for (const Meta& m : asArray()) {
+                h ^= m.hash();
             }
             return h;
         }
@@ -466,6 +490,10 @@ namespace basil {
 
     // MetaRC
 
+#ifdef BASIL_STATS
+    u64 MetaRC::incs = 0, MetaRC::decs = 0;
+#endif
+
     MetaRC::MetaRC(): rc(1) {
         //
     }
@@ -475,10 +503,16 @@ namespace basil {
     }
      
     void MetaRC::inc() {
+#ifdef BASIL_STATS
+        incs ++;
+#endif
         rc ++;
     }
 
     void MetaRC::dec() {
+#ifdef BASIL_STATS
+        decs ++;
+#endif
         rc --;
         if (rc == 0) delete this;
     }
@@ -509,7 +543,7 @@ namespace basil {
     }
 
     MetaList::MetaList(Meta val, Meta next):
-        v(val), n(next) {
+        v(std::move(val)), n(std::move(next)) {
         //
     }
 
@@ -575,42 +609,85 @@ namespace basil {
 
     // MetaArray
 
-    MetaArray::MetaArray(const vector<Meta>& values): vals(values) {
+    void MetaArray::materialize() const {
+        for (u32 i = 0; i < _lazy; i ++) vals.push(Meta(I64, _first + i));
+        _lazy = 0;
+    }
+
+    MetaArray::MetaArray(): _first(0), _lazy(0) {
+        //
+    }
+
+    MetaArray::MetaArray(const vector<Meta>& values): 
+        vals(values), _first(0), _lazy(0) {
+        //
+    }
+
+    MetaArray::MetaArray(const pvector<Meta>& values): 
+        vals(values), _first(0), _lazy(0) {
+        //
+    }
+
+    MetaArray::MetaArray(i64 first, u32 count): _first(first), _lazy(count) {
         //
     }
 
-    const Meta& MetaArray::operator[](u32 i) const {
+    // Reading a lazy range doesn't materialize it.
+    Meta MetaArray::operator[](u32 i) const {
+        if (_lazy) return Meta(I64, _first + i);
         return vals[i];
     }
 
+    // The stored element, for callers that need its address.
+    const Meta& MetaArray::at(u32 i) const {
+        materialize();
+        return vals[i];
+    }
+
+    bool MetaArray::lazy() const {
+        return _lazy;
+    }
+
     Meta& MetaArray::operator[](u32 i) {
+        materialize();
         return vals[i];
     }
 
-    const Meta* MetaArray::begin() const {
+    pvector<Meta>::const_iterator MetaArray::begin() const {
+        materialize();
         return vals.begin();
     }
 
-    const Meta* MetaArray::end() const {
+    pvector<Meta>::const_iterator MetaArray::end() const {
+        materialize();
         return vals.end();
     }
 
-    Meta* MetaArray::begin() {
-        return vals.begin();
+    const pvector<Meta>& MetaArray::values() const {
+        materialize();
+        return vals;
     }
 
-    Meta* MetaArray::end() {
-        return vals.end();
+    void MetaArray::push(const Meta& m) {
+        materialize();
+        vals.push(m);
     }
 
     u32 MetaArray::size() const {
-        return vals.size();
+        return vals.size() + _lazy;
     }
 
     Meta MetaArray::clone(const Meta& src) const {
-        vector<Meta> copies;
-        for (const Meta& m : *this) copies.push(m.clone());
-        return Meta(src.type(), new MetaArray(copies));
+        if (_lazy) return Meta(src.type(), new MetaArray(_first, _lazy));
+
+        // plain elements can stay shared with this array
+        MetaArray* a = new MetaArray(vals);
+        u32 i = 0;
+        for (const Meta& m : vals) {
+            if (m.kind() >= META_STRING) (*a)[i] = m.clone();
+            i ++;
+        }
+        return Meta(src.type(), a);
     }
 
     // MetaUnion
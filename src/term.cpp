@@ -366,7 +366,7 @@ namespace basil {
     }
 
     Meta EmptyTerm::fold() const {
-        return Meta(type(), new MetaArray({}));
+        return Meta(type(), new MetaArray());
     }
 
     void EmptyTerm::repr(stream& io) const {
@@ -379,7 +379,7 @@ namespace basil {
 
     VariableTerm::VariableTerm(const ustring& name, u32 line, u32 column,
                                 const TermClass* tc):
-        Term(line, column, tc), _name(name) {
+        Term(line, column, tc), _name(name), _symbol(findSymbol(name)) {
         //
     }
 
@@ -389,6 +389,7 @@ namespace basil {
 
     void VariableTerm::rename(const ustring& name) {
         _name = name;
+        _symbol = findSymbol(name);
     }
 
     void VariableTerm::format(stream& io, u32 level) const {
@@ -420,7 +421,7 @@ namespace basil {
     }
 
     Meta VariableTerm::fold() const {
-        return Meta(SYMBOL, _name);
+        return Meta(SYMBOL, (i64)_symbol);
     }
 
     void VariableTerm::repr(stream& io) const {
@@ -433,7 +434,7 @@ namespace basil {
 
     BlockTerm::BlockTerm(const vector<Term*>& children, u32 line, u32 column,
                             const TermClass* tc):
-        Term(line, column, tc) {
+        Term(line, column, tc), _cachetype(nullptr) {
         _children = children;
         for (Term* t : _children) t->setParent(this);
     }
@@ -444,6 +445,8 @@ namespace basil {
 
     void BlockTerm::add(Term* child) {
         _children.push(child);
+        _cachetype = nullptr;
+        _cachefold = Meta();
     }
 
     void BlockTerm::format(stream& io, u32 level) const {
@@ -487,12 +490,14 @@ namespace basil {
     }
 
     const Type* BlockTerm::type() const {
+        if (_cachetype) return _cachetype;
         vector<const Type*> ts;
         for (Term* child : _children) ts.push(child->type());
-        return find<ArrayType>(ts);
+        return _cachetype = find<ArrayType>(ts);
     }
 
     Meta BlockTerm::fold() const {
+        if (_cachefold) return _cachefold;
         vector<Meta> metas;
         const ArrayType* mytype = type()->as<ArrayType>();;
         for (Term* child : _children) {
@@ -500,7 +505,7 @@ namespace basil {
                 metas.push(Meta(mytype->element(), new MetaUnion(child->fold())));
             else metas.push(child->fold());
         }
-        return Meta(type(), new MetaArray(metas));
+        return _cachefold = Meta(type(), new MetaArray(metas));
     }
 
     void BlockTerm::repr(stream& io) const {
@@ -623,13 +628,73 @@ namespace basil {
     } 
 
     void ProgramTerm::eval(Stack& stack) {
+        flushMeta();
         for (Term* t : _children) {
+            refuel(t->line(), t->column());
             if (global->expectsMeta()) {
                 global->push(new Quote(t, t->line(), t->column()));
             }
             else t->eval(*global);
         }
-        for (Value* v : *global) v->type(*global);
+        flushMeta();
+        for (Value* v : *global) {
+            refuel(v->line(), v->column());
+            v->type(*global);
+        }
+        
+        vector<Value*> vals;
+        for (Value* v : *global) vals.push(v);
+        stack.push(new Program(vals, 1, 1)); 
+    }
+
+    static bool isLambda(const Term* t) {
+        if (!t->is<BlockTerm>()) return false;
+        const vector<Term*>& ts = t->as<BlockTerm>()->children();
+        if (ts.size() != 3 || !ts[0]->is<VariableTerm>()) return false;
+        const ustring& head = ts[0]->as<VariableTerm>()->name();
+        return head == "lambda" || head == "λ";
+    }
+
+    static bool isConstant(const Term* t) {
+        return t->is<IntegerTerm>() || t->is<RationalTerm>() 
+            || t->is<StringTerm>() || t->is<CharTerm>() || t->is<BoolTerm>();
+    }
+
+    // Recognizes 'name = ...' and 'name args -> ...' at the top level, 
+    // where evaluating the definition can't have any effects: the value is
+    // a function or a constant. Anything else is evaluated in place.
+    static const ustring* definedName(const Term* t) {
+        if (!t->is<BlockTerm>()) return nullptr;
+        const vector<Term*>& ts = t->as<BlockTerm>()->children();
+        if (ts.size() != 3 || !ts[0]->is<VariableTerm>()) return nullptr;
+        const ustring& head = ts[0]->as<VariableTerm>()->name();
+        if (head == "assign" && ts[1]->is<VariableTerm>()
+            && (isLambda(ts[2]) || isConstant(ts[2])))
+            return &ts[1]->as<VariableTerm>()->name();
+        if (isLambda(t) && ts[1]->is<BlockTerm>()) {
+            const vector<Term*>& m = ts[1]->as<BlockTerm>()->children();
+            if (m.size() > 1 && m[0]->is<VariableTerm>()) 
+                return &m[0]->as<VariableTerm>()->name();
+        }
+        return nullptr;
+    }
+
+    void ProgramTerm::evalLazily(Stack& stack) {
+        flushMeta();
+        for (Term* t : _children) {
+            refuel(t->line(), t->column());
+            const ustring* name = definedName(t);
+            if (name && !global->declared(*name)) global->defer(*name, t);
+            else if (global->expectsMeta()) {
+                global->push(new Quote(t, t->line(), t->column()));
+            }
+            else t->eval(*global);
+        }
+        flushMeta();
+        for (Value* v : *global) {
+            refuel(v->line(), v->column());
+            v->type(*global);
+        }
         
         vector<Value*> vals;
         for (Value* v : *global) vals.push(v);
@@ -642,8 +707,13 @@ namespace basil {
 
     void ProgramTerm::evalChild(Stack& stack, Term* t) {
         Stack* local = new Stack(global);
+        refuel(t->line(), t->column());
         t->eval(*local);
-        for (Value* v : *local) v->type(*local);
+        flushMeta();
+        for (Value* v : *local) {
+            refuel(v->line(), v->column());
+            v->type(*local);
+        }
         stack.copy(*local);
     }
     
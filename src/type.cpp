@@ -2,7 +2,33 @@
 #include "io.h"
 
 namespace basil {
-    map<ustring, const Type*> typemap;
+    TypeSlot* typetable = nullptr;
+    u32 typemask = 0;
+    static u32 typecount = 0;
+
+    void internType(u64 hash, const Type* t) {
+        if (!typetable || (typecount + 1) * 2 > typemask + 1) {
+            TypeSlot* old = typetable;
+            u32 oldsize = old ? typemask + 1 : 0;
+            typemask = old ? typemask * 2 + 1 : 255;
+            typetable = new TypeSlot[typemask + 1];
+            for (u32 i = 0; i <= typemask; i ++) typetable[i] = { 0, nullptr };
+            for (u32 i = 0; i < oldsize; i ++) if (old[i].type) {
+                u32 j = old[i].hash & typemask;
+                while (typetable[j].type) j = (j + 1) & typemask;
+                typetable[j] = old[i];
+            }
+            if (old) delete[] old;
+        }
+        u32 i = hash & typemask;
+        while (typetable[i].type) i = (i + 1) & typemask;
+        typetable[i] = { hash, t };
+        typecount ++;
+    }
+
+    static u64 mix(u64 h, u64 v) {
+        return rotl(h, 13) ^ (v * 0x9e3779b97f4a7c15ul);
+    }
 
     // TypeClass
 
@@ -35,11 +61,100 @@ namespace basil {
         return _id;
     }
 
+    const TypeClass* Type::typeclass() const {
+        return _typeclass;
+    }
+
+    u64 Type::shape(const ustring& key, u32 size) {
+        return mix(::hash(key), size);
+    }
+
+    bool Type::same(const ustring& key, u32 size) const {
+        return _key == key && _size == size;
+    }
+
+    // Coercion results are cached per pair of type ids. Each row belongs
+    // to a source type, and holds two bitsets over target ids: one marking
+    // which relations have been computed, and one holding their results.
+    // Types are immutable once interned, so cached results never go stale.
+    struct RelationRow {
+        u64* known;
+        u64* holds;
+        u32 words;
+    };
+
+    struct RelationCache {
+        RelationRow* rows;
+        u32 count;
+    };
+
+    static RelationCache implicitCache, explicitCache;
+
+    static RelationRow& rowOf(RelationCache& cache, u32 a) {
+        if (a >= cache.count) {
+            u32 count = cache.count ? cache.count : 64;
+            while (count <= a) count *= 2;
+            RelationRow* rows = new RelationRow[count];
+            for (u32 i = 0; i < cache.count; i ++) rows[i] = cache.rows[i];
+            for (u32 i = cache.count; i < count; i ++) {
+                rows[i] = { nullptr, nullptr, 0 };
+            }
+            delete[] cache.rows;
+            cache.rows = rows, cache.count = count;
+        }
+        return cache.rows[a];
+    }
+
+    // Returns -1 if the relation between a and b is not yet known.
+    static i32 lookup(RelationCache& cache, u32 a, u32 b) {
+        const RelationRow& row = rowOf(cache, a);
+        u32 word = b / 64;
+        u64 bit = 1ul << (b % 64);
+        if (word >= row.words || !(row.known[word] & bit)) return -1;
+        return (row.holds[word] & bit) ? 1 : 0;
+    }
+
+    static void record(RelationCache& cache, u32 a, u32 b, bool result) {
+        RelationRow& row = rowOf(cache, a);
+        u32 word = b / 64;
+        if (word >= row.words) {
+            u32 words = row.words ? row.words : 1;
+            while (words <= word) words *= 2;
+            u64 *known = new u64[words], *holds = new u64[words];
+            for (u32 i = 0; i < words; i ++) {
+                known[i] = i < row.words ? row.known[i] : 0;
+                holds[i] = i < row.words ? row.holds[i] : 0;
+            }
+            delete[] row.known;
+            delete[] row.holds;
+            row.known = known, row.holds = holds, row.words = words;
+        }
+        u64 bit = 1ul << (b % 64);
+        row.known[word] |= bit;
+        if (result) row.holds[word] |= bit;
+    }
+
     bool Type::implicitly(const Type* other) const {
-        return other == this || other == ANY;
+        i32 known = lookup(implicitCache, _id, other->_id);
+        if (known >= 0) return known;
+        bool result = lazyImplicitly(other);
+        record(implicitCache, _id, other->_id, result);
+        return result;
     }
 
     bool Type::explicitly(const Type* other) const {
+        i32 known = lookup(explicitCache, _id, other->_id);
+        if (known >= 0) return known;
+        bool result = lazyExplicitly(other);
+        record(explicitCache, _id, other->_id, result);
+        return result;
+    }
+
+    bool Type::lazyImplicitly(const Type* other) const {
+        return other == this || other == ANY;
+    }
+
+    bool Type::lazyExplicitly(const Type* other) const {
         return other == this || other == ANY;
     }
     
@@ -77,8 +192,16 @@ namespace basil {
         return _floating;
     }
 
-    bool NumericType::implicitly(const Type* other) const {
-        if (Type::implicitly(other)) return true;
+    u64 NumericType::shape(u32 size, bool floating) {
+        return mix(size, floating);
+    }
+
+    bool NumericType::same(u32 size, bool floating) const {
+        return _size == size && _floating == floating;
+    }
+
+    bool NumericType::lazyImplicitly(const Type* other) const {
+        if (Type::lazyImplicitly(other)) return true;
         if (!other->is<NumericType>()) return false;
         const NumericType* nt = other->as<NumericType>();
 
@@ -90,8 +213,8 @@ namespace basil {
         }
     }
 
-    bool NumericType::explicitly(const Type* other) const {
-        if (Type::explicitly(other)) return true;
+    bool NumericType::lazyExplicitly(const Type* other) const {
+        if (Type::lazyExplicitly(other)) return true;
         return other->is<NumericType>() &&
             (_floating ? other->as<NumericType>()->_floating : true);
     }
@@ -128,8 +251,21 @@ namespace basil {
         return _members.size();
     }
 
-    bool TupleType::implicitly(const Type* other) const {
-        if (Type::implicitly(other)) return true;
+    u64 TupleType::shape(const vector<const Type*>& members) {
+        u64 h = members.size();
+        for (const Type* t : members) h = mix(h, t->id());
+        return h;
+    }
+
+    bool TupleType::same(const vector<const Type*>& members) const {
+        if (members.size() != _members.size()) return false;
+        for (u32 i = 0; i < members.size(); i ++) 
+            if (members[i] != _members[i]) return false;
+        return true;
+    }
+
+    bool TupleType::lazyImplicitly(const Type* other) const {
+        if (Type::lazyImplicitly(other)) return true;
         if (!other->is<TupleType>()) return false;
 
         const TupleType* tt = other->as<TupleType>();
@@ -142,8 +278,8 @@ namespace basil {
         return true;
     }
 
-    bool TupleType::explicitly(const Type* other) const {
-        if (Type::explicitly(other)) return true;
+    bool TupleType::lazyExplicitly(const Type* other) const {
+        if (Type::lazyExplicitly(other)) return true;
         if (other == TYPE) {
             bool anyNonType = false;
             for (const Type* t : _members) if (t != TYPE) anyNonType = true;
@@ -215,9 +351,33 @@ namespace basil {
     bool ArrayType::sized() const {
         return _count >= 0;
     }
+
+    u64 ArrayType::shape(const Type* element) {
+        return mix(element->id(), -1);
+    }
+
+    u64 ArrayType::shape(const Type* element, u32 size) {
+        return mix(element->id(), size);
+    }
+
+    u64 ArrayType::shape(const vector<const Type*>& elements) {
+        return shape(unionOf(elements), elements.size());
+    }
+
+    bool ArrayType::same(const Type* element) const {
+        return _element == element && _count == -1;
+    }
+
+    bool ArrayType::same(const Type* element, u32 size) const {
+        return _element == element && _count == size;
+    }
+
+    bool ArrayType::same(const vector<const Type*>& elements) const {
+        return same(unionOf(elements), elements.size());
+    }
     
-    bool ArrayType::implicitly(const Type* other) const {
-        if (Type::implicitly(other)) return true;
+    bool ArrayType::lazyImplicitly(const Type* other) const {
+        if (Type::lazyImplicitly(other)) return true;
         if (other->is<TupleType>()) {
             const TupleType* tt = other->as<TupleType>();
             for (const Type* t : tt->members()) {
@@ -233,8 +393,8 @@ namespace basil {
         return _element->implicitly(at->element());   
     }
     
-    bool ArrayType::explicitly(const Type* other) const {
-        if (Type::implicitly(other)) return true;
+    bool ArrayType::lazyExplicitly(const Type* other) const {
+        if (Type::lazyImplicitly(other)) return true;
         if (other->is<TupleType>()) {
             const TupleType* tt = other->as<TupleType>();
             for (const Type* t : tt->members()) {
@@ -263,32 +423,103 @@ namespace basil {
 
     const TypeClass UnionType::CLASS(Type::CLASS);
 
+    // TypeMembers
+
+    static const u32 MEMBER_BITSET_MIN = 8;
+
+    TypeMembers::TypeMembers(const set<const Type*>& types):
+        _types(new const Type*[types.size()]), _bits(nullptr), 
+        _size(0), _words(0) {
+        for (const Type* t : types) {
+            _types[_size ++] = t;
+            for (u32 i = _size - 1; i > 0; i --) {
+                if (_types[i - 1]->id() < _types[i]->id()) break;
+                const Type* tmp = _types[i];
+                _types[i] = _types[i - 1], _types[i - 1] = tmp;
+            }
+        }
+        if (_size >= MEMBER_BITSET_MIN) {
+            _words = _types[_size - 1]->id() / 64 + 1;
+            _bits = new u64[_words];
+            for (u32 i = 0; i < _words; i ++) _bits[i] = 0;
+            for (u32 i = 0; i < _size; i ++) {
+                _bits[_types[i]->id() / 64] |= 1ul << (_types[i]->id() % 64);
+            }
+        }
+    }
+
+    TypeMembers::~TypeMembers() {
+        delete[] _types;
+        if (_bits) delete[] _bits;
+    }
+
+    u32 TypeMembers::size() const {
+        return _size;
+    }
+
+    bool TypeMembers::has(const Type* t) const {
+        if (_bits) {
+            u32 word = t->id() / 64;
+            return word < _words && (_bits[word] & (1ul << (t->id() % 64)));
+        }
+        for (u32 i = 0; i < _size; i ++) if (_types[i] == t) return true;
+        return false;
+    }
+
+    bool TypeMembers::same(const set<const Type*>& types) const {
+        if (types.size() != _size) return false;
+        for (const Type* t : types) if (!has(t)) return false;
+        return true;
+    }
+
+    const Type* const* TypeMembers::begin() const {
+        return _types;
+    }
+
+    const Type* const* TypeMembers::end() const {
+        return _types + _size;
+    }
+
     UnionType::UnionType(const set<const Type*>& members,
                          const TypeClass* tc):
         Type("", 0, tc), _members(members) {
         _key += "[U";
-        for (const Type* t : members) {
+        for (const Type* t : _members) {
             if (t->size() > _size) _size = t->size();
             _key += " ", _key += t->key();
         }
         _key += "]";
     }
 
-    const set<const Type*>& UnionType::members() const {
+    const TypeMembers& UnionType::members() const {
         return _members;
     }
 
     bool UnionType::has(const Type* t) const {
-        return _members.find(t) != _members.end();
+        return _members.has(t);
+    }
+
+    static u64 shapeOf(const set<const Type*>& members) {
+        u64 h = members.size();
+        for (const Type* t : members) h += mix(0, t->id() + 1);
+        return h;
+    }
+
+    u64 UnionType::shape(const set<const Type*>& members) {
+        return shapeOf(members);
+    }
+
+    bool UnionType::same(const set<const Type*>& members) const {
+        return _members.same(members);
     }
 
-    bool UnionType::implicitly(const Type* other) const {
-        if (Type::implicitly(other)) return true;
+    bool UnionType::lazyImplicitly(const Type* other) const {
+        if (Type::lazyImplicitly(other)) return true;
         return other == this;
     }
 
-    bool UnionType::explicitly(const Type* other) const {
-        if (Type::explicitly(other)) return true;
+    bool UnionType::lazyExplicitly(const Type* other) const {
+        if (Type::lazyExplicitly(other)) return true;
         if (other == TYPE) {
             bool anyNonType = false;
             for (const Type* t : _members) if (t != TYPE) anyNonType = true;
@@ -318,7 +549,7 @@ namespace basil {
         _key += "[I";
         bool overload = true;
         const Type* prev = nullptr;
-        for (const Type* t : members) {
+        for (const Type* t : _members) {
             if (prev && 
                 (!prev->is<FunctionType>()
                  || !t->is<FunctionType>()
@@ -333,21 +564,29 @@ namespace basil {
         _key += "]";
     }
 
-    const set<const Type*>& IntersectionType::members() const {
+    const TypeMembers& IntersectionType::members() const {
         return _members;
     }
 
     bool IntersectionType::has(const Type* t) const {
-        return _members.find(t) != _members.end();
+        return _members.has(t);
     }
 
-    bool IntersectionType::implicitly(const Type* other) const {
-        if (Type::implicitly(other)) return true;
+    u64 IntersectionType::shape(const set<const Type*>& members) {
+        return shapeOf(members);
+    }
+
+    bool IntersectionType::same(const set<const Type*>& members) const {
+        return _members.same(members);
+    }
+
+    bool IntersectionType::lazyImplicitly(const Type* other) const {
+        if (Type::lazyImplicitly(other)) return true;
         return this == other;
     }
 
-    bool IntersectionType::explicitly(const Type* other) const {
-        if (Type::explicitly(other)) return true;
+    bool IntersectionType::lazyExplicitly(const Type* other) const {
+        if (Type::lazyExplicitly(other)) return true;
         if (other == TYPE) {
             bool anyNonType = false;
             for (const Type* t : _members) if (t != TYPE) anyNonType = true;
@@ -389,12 +628,20 @@ namespace basil {
         return _element;
     }
 
-    bool ListType::implicitly(const Type* other) const {
-        if (Type::implicitly(other)) return true;
+    u64 ListType::shape(const Type* element) {
+        return element->id();
+    }
+
+    bool ListType::same(const Type* element) const {
+        return _element == element;
+    }
+
+    bool ListType::lazyImplicitly(const Type* other) const {
+        if (Type::lazyImplicitly(other)) return true;
         return other == this;
     }
 
-    bool ListType::explicitly(const Type* other) const {
+    bool ListType::lazyExplicitly(const Type* other) const {
         return implicitly(other); // todo: consider reification?
     }
 
@@ -417,12 +664,20 @@ namespace basil {
         return _element;
     }
 
-    bool ReferenceType::implicitly(const Type* other) const {
-        if (Type::implicitly(other)) return true;
+    u64 ReferenceType::shape(const Type* element) {
+        return element->id();
+    }
+
+    bool ReferenceType::same(const Type* element) const {
+        return _element == element;
+    }
+
+    bool ReferenceType::lazyImplicitly(const Type* other) const {
+        if (Type::lazyImplicitly(other)) return true;
         return other == _element || other == this;
     }
 
-    bool ReferenceType::explicitly(const Type* other) const {
+    bool ReferenceType::lazyExplicitly(const Type* other) const {
         if (other == TYPE) return _element == TYPE;
         return implicitly(other); // todo: consider reification?
     }
@@ -440,12 +695,20 @@ namespace basil {
         //
     }
 
-    bool EmptyType::implicitly(const Type* other) const {
-        if (Type::implicitly(other)) return true;
+    u64 EmptyType::shape() {
+        return 0;
+    }
+
+    bool EmptyType::same() const {
+        return true;
+    }
+
+    bool EmptyType::lazyImplicitly(const Type* other) const {
+        if (Type::lazyImplicitly(other)) return true;
         return other == this || other->is<ListType>();
     }
 
-    bool EmptyType::explicitly(const Type* other) const {
+    bool EmptyType::lazyExplicitly(const Type* other) const {
         return implicitly(other);
     }
 
@@ -468,7 +731,7 @@ namespace basil {
                                bool quoting, const vector<Constraint>& cons,
                                const TypeClass* tc):
         Type("", 0, tc), _arg(arg), _ret(ret), 
-        _cons(cons), _quoting(quoting) {
+        _cons(cons), _quoting(quoting), _defaultcons(!cons.size()) {
         if (!_cons.size()) _cons.push(Constraint());
         _key += (quoting ? "[QF " : "[F ");
         _key += arg->key();
@@ -497,6 +760,43 @@ namespace basil {
         return _cons;
     }
 
+    u64 FunctionType::shape(const Type* arg, const Type* ret, bool quoting) {
+        return mix(mix(arg->id(), ret->id()), quoting);
+    }
+
+    u64 FunctionType::shape(const Type* arg, const Type* ret, 
+                            const vector<Constraint>& cons) {
+        return shape(arg, ret, false, cons);
+    }
+
+    u64 FunctionType::shape(const Type* arg, const Type* ret, bool quoting,
+                            const vector<Constraint>& cons) {
+        u64 h = shape(arg, ret, quoting);
+        for (const Constraint& c : cons) h = mix(h, c.hash());
+        return h;
+    }
+
+    bool FunctionType::same(const Type* arg, const Type* ret, 
+                            bool quoting) const {
+        return _arg == arg && _ret == ret && _quoting == quoting 
+            && _defaultcons;
+    }
+
+    bool FunctionType::same(const Type* arg, const Type* ret, 
+                            const vector<Constraint>& cons) const {
+        return same(arg, ret, false, cons);
+    }
+
+    bool FunctionType::same(const Type* arg, const Type* ret, bool quoting,
+                            const vector<Constraint>& cons) const {
+        if (!cons.size()) return same(arg, ret, quoting);
+        if (_arg != arg || _ret != ret || _quoting != quoting 
+            || _defaultcons || _cons.size() != cons.size()) return false;
+        for (u32 i = 0; i < cons.size(); i ++) 
+            if (!(_cons[i] == cons[i])) return false;
+        return true;
+    }
+
     bool FunctionType::total() const {
         vector<Meta> vals;
         for (const Constraint& c : _cons) {
@@ -517,8 +817,8 @@ namespace basil {
         return false;
     }
 
-    bool FunctionType::implicitly(const Type* other) const {
-        if (Type::implicitly(other)) return true;
+    bool FunctionType::lazyImplicitly(const Type* other) const {
+        if (Type::lazyImplicitly(other)) return true;
         if (!other->is<FunctionType>()) return false;
 
         const FunctionType* ft = other->as<FunctionType>();
@@ -530,8 +830,8 @@ namespace basil {
             && ft->constraints()[0].type() == UNKNOWN;
     }
 
-    bool FunctionType::explicitly(const Type* other) const {
-        if (Type::explicitly(other)) return true;
+    bool FunctionType::lazyExplicitly(const Type* other) const {
+        if (Type::lazyExplicitly(other)) return true;
         if (other == TYPE) {
             return _arg == TYPE && _ret == TYPE && _cons.size() == 1
                 && _cons[0].type() == EQUALS_VALUE 
@@ -551,11 +851,11 @@ namespace basil {
         print(io, ")");
     }
 
-    Constraint FunctionType::matches(Meta fr) const {
+    Constraint FunctionType::matches(const Meta& fr) const {
         return maxMatch(_cons, fr);
     }
 
-    Constraint maxMatch(const vector<Constraint>& cons, Meta fr) {
+    Constraint maxMatch(const vector<Constraint>& cons, const Meta& fr) {
         if (cons.size() == 0) return Constraint();
         Constraint ret = Constraint::NONE;
         for (const Constraint& c : cons) if (c.matches(fr)) {
@@ -572,7 +872,7 @@ namespace basil {
         _key = "";
     }
 
-    Constraint::Constraint(Meta value):
+    Constraint::Constraint(const Meta& value):
         _type(EQUALS_VALUE), _value(value) {
         _key = "(= ";
         _key += value.toString();
@@ -597,7 +897,7 @@ namespace basil {
         return _type;
     }
 
-    Meta Constraint::value() const {
+    const Meta& Constraint::value() const {
         return _value;
     }
 
@@ -605,6 +905,19 @@ namespace basil {
         return _type != NULL_CONSTRAINT;
     }
 
+    bool Constraint::operator==(const Constraint& other) const {
+        if (_type != other._type) return false;
+        if (_type == EQUALS_VALUE || _type == OF_TYPE) 
+            return _value == other._value;
+        return true;
+    }
+
+    u64 Constraint::hash() const {
+        if (_type == EQUALS_VALUE || _type == OF_TYPE) 
+            return mix(_type, _value.hash());
+        return _type;
+    }
+
     bool Constraint::conflictsWith(const Constraint& other) const {
         if (_type == UNKNOWN) return true;
         if (_type == other._type && _type == EQUALS_VALUE) {
@@ -622,7 +935,7 @@ namespace basil {
         return _key;
     }
 
-    bool Constraint::matches(Meta value) const {
+    bool Constraint::matches(const Meta& value) const {
         if (_type == UNKNOWN || _type == OF_TYPE) return true;
         if (_type == EQUALS_VALUE) return value == _value;
         return false;
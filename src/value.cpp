@@ -8,6 +8,8 @@
 #include "errors.h"
 #include "import.h"
 #include "ir.h"
+#include <unistd.h>
+#include <sys/wait.h>
 
 namespace basil {
 
@@ -15,20 +17,23 @@ namespace basil {
 
     Stack::Entry::Entry(const Type* type, Stack::builtin_t builtin):
         _type(type), _meta(nullptr), _builtin(builtin),
-        _loc(nullptr), _reassigned(false), _storage(STORAGE_LOCAL) {
+        _loc(nullptr), _reassigned(false), _known(false), 
+        _storage(STORAGE_LOCAL) {
         //
     }
 
     Stack::Entry::Entry(const Type* type, const Meta& value, builtin_t builtin):
         _type(type), _value(value), _meta(nullptr), 
         _builtin(builtin),
-        _loc(nullptr), _reassigned(false), _storage(STORAGE_LOCAL) {
+        _loc(nullptr), _reassigned(false), _known(false), 
+        _storage(STORAGE_LOCAL) {
         //
     }
 
     Stack::Entry::Entry(const Type* type, Value* meta, builtin_t builtin):
         _type(type), _meta(meta), _builtin(builtin),
-        _loc(nullptr), _reassigned(false), _storage(STORAGE_LOCAL) {
+        _loc(nullptr), _reassigned(false), _known(false), 
+        _storage(STORAGE_LOCAL) {
         //
     }
     
@@ -84,10 +89,132 @@ namespace basil {
         return _reassigned;
     }
 
+    u32 Stack::Entry::_reassignments = 0;
+
     void Stack::Entry::reassign() {
+        if (!_reassigned) _reassignments ++;
         _reassigned = true;
     }
 
+    u32 Stack::Entry::reassignments() {
+        return _reassignments;
+    }
+
+    // Whether the value bound at definition is the one the variable has at
+    // runtime, so uses of it can be folded.
+    bool Stack::Entry::known() const {
+        return _known;
+    }
+
+    bool& Stack::Entry::known() {
+        return _known;
+    }
+
+    // Stack::Scope
+
+    Stack::Scope::Scope(): 
+        _entries(nullptr), _size(0), _capacity(0), _index(nullptr) {
+        //
+    }
+
+    Stack::Scope::~Scope() {
+        if (_entries) delete[] _entries;
+        if (_index) delete _index;
+    }
+
+    Stack::Scope::Scope(const Scope& other): Scope() {
+        *this = other;
+    }
+
+    Stack::Scope& Stack::Scope::operator=(const Scope& other) {
+        if (this != &other) {
+            if (_entries) delete[] _entries;
+            if (_index) delete _index;
+            _size = _capacity = other._size;
+            _entries = _size ? new pair<ustring, Entry>[_size] : nullptr;
+            for (u32 i = 0; i < _size; i ++) _entries[i] = other._entries[i];
+            _index = other._index ? new map<ustring, u32>(*other._index) : nullptr;
+        }
+        return *this;
+    }
+
+    u32 Stack::Scope::slot(const ustring& name) const {
+        if (_index) {
+            auto it = _index->find(name);
+            return it == _index->end() ? _size : it->second;
+        }
+        for (u32 i = 0; i < _size; i ++) {
+            if (_entries[i].first == name) return i;
+        }
+        return _size;
+    }
+
+    void Stack::Scope::reindex() {
+        if (!_index) _index = new map<ustring, u32>();
+        for (u32 i = 0; i < _size; i ++) _index->put(_entries[i].first, i);
+    }
+
+    u32 Stack::Scope::size() const {
+        return _size;
+    }
+
+    const Stack::Entry* Stack::Scope::find(const ustring& name) const {
+        u32 i = slot(name);
+        return i < _size ? &_entries[i].second : nullptr;
+    }
+
+    Stack::Entry* Stack::Scope::find(const ustring& name) {
+        u32 i = slot(name);
+        return i < _size ? &_entries[i].second : nullptr;
+    }
+
+    bool Stack::Scope::has(const ustring& name) const {
+        return slot(name) < _size;
+    }
+
+    Stack::Entry& Stack::Scope::operator[](const ustring& name) {
+        u32 i = slot(name);
+        if (i < _size) return _entries[i].second;
+        if (_size == _capacity) {
+            _capacity = _capacity ? _capacity * 2 : 4;
+            pair<ustring, Entry>* entries = new pair<ustring, Entry>[_capacity];
+            for (u32 j = 0; j < _size; j ++) entries[j] = std::move(_entries[j]);
+            if (_entries) delete[] _entries;
+            _entries = entries;
+        }
+        _entries[_size ++].first = name;
+        if (_index) _index->put(name, i);
+        else if (_size > INDEX_MIN) reindex();
+        return _entries[i].second;
+    }
+
+    void Stack::Scope::erase(const ustring& name) {
+        u32 i = slot(name);
+        if (i == _size) return;
+        if (_index) _index->erase(name);
+        if (i != -- _size) {
+            _entries[i] = std::move(_entries[_size]);
+            if (_index) (*_index)[_entries[i].first] = i;
+        }
+        _entries[_size] = pair<ustring, Entry>();
+    }
+
+    const pair<ustring, Stack::Entry>* Stack::Scope::begin() const {
+        return _entries;
+    }
+
+    pair<ustring, Stack::Entry>* Stack::Scope::begin() {
+        return _entries;
+    }
+
+    const pair<ustring, Stack::Entry>* Stack::Scope::end() const {
+        return _entries + _size;
+    }
+
+    pair<ustring, Stack::Entry>* Stack::Scope::end() {
+        return _entries + _size;
+    }
+
     ustring interactName(const Type* a, const Type* b) {
         return "#[" + a->key() + " " + b->key() + "]";
     }
@@ -189,7 +316,7 @@ namespace basil {
 
     Stack::Entry* Stack::tryInteract(Value* first, Value* second) {
         Stack* s = this;
-        while (s && !s->tmcache) {
+        while (s && !s->tmethods) {
             s = s->_parent;
         }
         if (!s) return nullptr;
@@ -201,8 +328,8 @@ namespace basil {
         if (it == cache->end()) {
             set<pair<const Type*, const Type*>> methods;
             Stack* s = this;
-            while (s && !s->tmcache) s = s->_parent;
-            while (s && s->tmcache) {
+            while (s && !s->tmethods) s = s->_parent;
+            while (s) {
                 for (auto& e : *s->tmethods) {
                     if (ft->explicitly(e.first.first)) {
                         methods.insert({ e.first.first, e.first.second });
@@ -211,7 +338,7 @@ namespace basil {
 
                 // traverse up
                 s = s->_parent;
-                while (s && !s->tmcache) s = s->_parent;
+                while (s && !s->tmethods) s = s->_parent;
             }
             cache->put(ft, methods);
 
@@ -244,27 +371,30 @@ namespace basil {
     
     Stack::Stack(Stack* parent, bool scope): 
         _parent(parent),
-        table(scope ? new map<ustring, Entry>() : nullptr),
-        tmethods(scope ? new tmscope_t() : nullptr),
-        tmcache(scope ? new tmcache_t() : nullptr),
+        table(scope ? new Scope() : nullptr),
+        imports(nullptr), deferred(nullptr), deferredsrc(nullptr),
+        instances(nullptr), tmethods(nullptr), tmcache(nullptr),
         _depth(parent ? parent->depth() + 1 : 0) {
         if (parent) parent->_children.push(this);
-        if (tmcache) {
-            // copy nearest parent's tmcache
-            Stack* s = _parent;
-            while (s && !s->table && s->_parent) s = s->_parent;
-            if (s) *tmcache = *s->tmcache;
-        }
     }
 
     Stack::~Stack() {
         if (table) delete table;
+        if (imports) delete imports;
+        if (deferred) delete deferred;
+        if (instances) delete instances;
+        if (tmethods) delete tmethods;
+        if (tmcache) delete tmcache;
         for (Stack* s : _children) delete s;
     }
 
     Stack::Stack(const Stack& other): 
-        _parent(other._parent), values(other.values), _depth(other.depth()) {
-        table = other.table ? new map<ustring, Entry>(*other.table) : nullptr;
+        _parent(other._parent), values(other.values), instances(nullptr),
+        _depth(other.depth()) {
+        table = other.table ? new Scope(*other.table) : nullptr;
+        imports = other.imports ? new vector<Stack*>(*other.imports) : nullptr;
+        deferred = other.deferred ? new map<ustring, Term*>(*other.deferred) : nullptr;
+        deferredsrc = other.deferredsrc;
         tmethods = other.tmethods ? new tmscope_t(*other.tmethods) : nullptr;
         tmcache = other.tmcache ? new tmcache_t(*other.tmcache) : nullptr;
         for (Stack* s : other._children) {
@@ -275,12 +405,19 @@ namespace basil {
     Stack& Stack::operator=(const Stack& other) {
         if (this != &other) {
             if (table) delete table;
+            if (imports) delete imports;
+            if (deferred) delete deferred;
+            if (instances) delete instances;
             if (tmethods) delete tmethods;
             if (tmcache) delete tmcache;
             for (Stack* s : _children) delete s;
+            instances = nullptr;
             _parent = other._parent;
             values = other.values;
-            table = other.table ? new map<ustring, Entry>(*other.table) : nullptr;
+            table = other.table ? new Scope(*other.table) : nullptr;
+            imports = other.imports ? new vector<Stack*>(*other.imports) : nullptr;
+            deferred = other.deferred ? new map<ustring, Term*>(*other.deferred) : nullptr;
+            deferredsrc = other.deferredsrc;
             tmethods = other.tmethods ? new tmscope_t(*other.tmethods) : nullptr;
             tmcache = other.tmcache ? new tmcache_t(*other.tmcache) : nullptr;
             for (Stack* s : other._children) {
@@ -406,42 +543,180 @@ namespace basil {
         return table;
     }
 
+    // Modules see the modules they used themselves, so imports are 
+    // searched transitively, in the order they were used.
+    const Stack* Stack::imported(const ustring& name) const {
+        if (imports) for (const Stack* s : *imports) {
+            if (s->table->has(name)) return s;
+            if (const Stack* t = s->imported(name)) return t;
+        }
+        return nullptr;
+    }
+
+    Stack* Stack::imported(const ustring& name) {
+        if (imports) for (Stack* s : *imports) {
+            if (s->deferred) s->force(name);
+            if (s->table->has(name)) return s;
+            if (Stack* t = s->imported(name)) return t;
+        }
+        return nullptr;
+    }
+
     const Stack::Entry* Stack::operator[](const ustring& name) const {
         if (table) {
-            auto it = table->find(name);
-            if (it != table->end()) return &(it->second);
+            if (const Entry* e = table->find(name)) return e;
         }
+        if (const Stack* s = imported(name)) return s->table->find(name);
         if (_parent) return (*_parent)[name];
         return nullptr;
     }
 
     Stack::Entry* Stack::operator[](const ustring& name) {
+        if (deferred) force(name);
         if (table) {
-            auto it = table->find(name);
-            if (it != table->end()) return &(it->second);
+            if (Entry* e = table->find(name)) return e;
         }
+        if (Stack* s = imported(name)) return s->table->find(name);
         if (_parent) return (*_parent)[name];
         return nullptr;
     }
 
     const Stack* Stack::findenv(const ustring& name) const {
-        if (table) {
-            auto it = table->find(name);
-            if (it != table->end()) return this;
-        }
+        if (table && table->has(name)) return this;
+        if (const Stack* s = imported(name)) return s;
         if (_parent) return _parent->findenv(name);
         return nullptr;
     }
 
     Stack* Stack::findenv(const ustring& name) {
-        if (table) {
-            auto it = table->find(name);
-            if (it != table->end()) return this;
-        }
+        if (deferred) force(name);
+        if (table && table->has(name)) return this;
+        if (Stack* s = imported(name)) return s;
         if (_parent) return _parent->findenv(name);
         return nullptr;
     }
 
+    static bool binds(const Stack::Scope* table,
+                      const map<ustring, Term*>* deferred, const ustring& name) {
+        return table->has(name)
+            || (deferred && deferred->find(name) != deferred->end());
+    }
+
+    bool Stack::importsDeclare(const ustring& name) const {
+        if (imports) for (const Stack* i : *imports) {
+            if (binds(i->table, i->deferred, name)) return true;
+            if (i->importsDeclare(name)) return true;
+        }
+        return false;
+    }
+
+    bool Stack::declared(const ustring& name) const {
+        const Stack* s = this;
+        while (s->_parent && !s->table) s = s->_parent;
+        return binds(s->table, s->deferred, name) || s->importsDeclare(name);
+    }
+
+    static bool contains(const Stack::Scope& s, const ustring& name) {
+        return s.has(name);
+    }
+
+    template<typename T>
+    static bool contains(const map<ustring, T>& m, const ustring& name) {
+        return m.find(name) != m.end();
+    }
+
+    template<typename T, typename U>
+    static const ustring* firstShared(const T& a, const U& b) {
+        if (a.size() > b.size()) return firstShared(b, a);
+        for (auto& p : a) if (contains(b, p.first)) return &p.first;
+        return nullptr;
+    }
+
+    void Stack::gatherImports(vector<const Stack*>& scopes) const {
+        if (imports) for (const Stack* i : *imports) {
+            bool seen = false;
+            for (const Stack* s : scopes) if (s == i) seen = true;
+            if (seen) continue;
+            scopes.push(i);
+            i->gatherImports(scopes);
+        }
+    }
+
+    static const ustring* sharedName(const Stack::Scope& a, 
+                                     const map<ustring, Term*>* adeferred,
+                                     const Stack::Scope& b,
+                                     const map<ustring, Term*>* bdeferred) {
+        const ustring* name = firstShared(a, b);
+        if (!name && adeferred) name = firstShared(*adeferred, b);
+        if (!name && bdeferred) name = firstShared(a, *bdeferred);
+        if (!name && adeferred && bdeferred) 
+            name = firstShared(*adeferred, *bdeferred);
+        return name;
+    }
+
+    // Finds a name that env, or a module it used, would bind over one 
+    // already visible here. The scope that binds it already is stored in 
+    // owner. Modules reached by both sides are the same bindings, not a
+    // conflict.
+    const ustring* Stack::collision(const Stack& env, 
+                                    const Stack*& owner) const {
+        const Stack* s = this;
+        while (s->_parent && !s->table) s = s->_parent;
+        vector<const Stack*> scopes, incoming;
+        scopes.push(s);
+        s->gatherImports(scopes);
+        incoming.push(&env);
+        env.gatherImports(incoming);
+        for (const Stack* i : scopes) for (const Stack* j : incoming) {
+            if (i == j) continue;
+            if (const ustring* name = sharedName(*i->table, i->deferred,
+                                                 *j->table, j->deferred)) {
+                owner = i;
+                return name;
+            }
+        }
+        return nullptr;
+    }
+
+    void Stack::import(Stack* env) {
+        if (!table && _parent) return _parent->import(env);
+        if (!imports) imports = new vector<Stack*>();
+        for (Stack* i : *imports) if (i == env) return;
+        imports->push(env);
+    }
+
+    void Stack::defer(const ustring& name, Term* t) {
+        if (!table && _parent) return _parent->defer(name, t);
+        if (!deferred) deferred = new map<ustring, Term*>();
+        deferred->put(name, t);
+        deferredsrc = currentSource();
+    }
+
+    Lambda* Stack::instance(const Term* body, const Type* arg) const {
+        if (!instances) return nullptr;
+        auto it = instances->find({ body, arg });
+        return it == instances->end() ? nullptr : it->second;
+    }
+
+    void Stack::addInstance(const Term* body, const Type* arg, Lambda* l) {
+        if (!instances) instances = new map<instkey_t, Lambda*>();
+        instances->put({ body, arg }, l);
+    }
+
+    void Stack::force(const ustring& name) {
+        auto it = deferred->find(name);
+        if (it == deferred->end()) return;
+        Term* t = it->second;
+        deferred->erase(name);
+
+        Source* prev = currentSource();
+        useSource(deferredsrc);
+        Stack* local = new Stack(this);
+        t->eval(*local);
+        for (Value* v : *local) v->type(*local);
+        useSource(prev);
+    }
+
     Stack::Entry* Stack::interactOf(const Type* a, const Type* b) {
         if (tmethods) {
             auto it = tmethods->find({ a, b });
@@ -455,7 +730,8 @@ namespace basil {
 
     void Stack::interact(const Type* a, const Type* b, const Meta& f) {
         const FunctionType* ft = find<FunctionType>(a, find<FunctionType>(b, ANY));
-        if (tmethods) {
+        if (table) {
+            if (!tmethods) tmethods = new tmscope_t(), tmcache = new tmcache_t();
             (*tmethods)[{a, b}] = Entry(ft, f);
             for (auto& p : *tmcache) if (p.first->explicitly(a)) 
                 p.second.insert({ a, b });
@@ -465,9 +741,10 @@ namespace basil {
 
     void Stack::interact(const Type* a, const Type* b, builtin_t f) {
         const FunctionType* ft = find<FunctionType>(a, find<FunctionType>(b, ANY));
-        if (tmethods) {
+        if (table) {
+            if (!tmethods) tmethods = new tmscope_t(), tmcache = new tmcache_t();
             (*tmethods)[{a, b}] = Entry(ft, f);
-            for (auto& p : *tmcache) if (p.first->explicitly(a))  
+            for (auto& p : *tmcache) if (p.first->explicitly(a)) 
                 p.second.insert({ a, b });
         }
         else if (_parent) _parent->interact(a, b, f);
@@ -513,9 +790,9 @@ namespace basil {
         return values.size();
     }
     
-    const map<ustring, Stack::Entry>& Stack::nearestScope() const {
+    const Stack::Scope& Stack::nearestScope() const {
         const Stack* s = this;
-        const map<ustring, Stack::Entry>* t = table;
+        const Scope* t = table;
         while (s->_parent && !t) {
             s = s->_parent;
             t = s->table;
@@ -523,9 +800,9 @@ namespace basil {
         return *t;
     }
     
-    map<ustring, Stack::Entry>& Stack::nearestScope() {
+    Stack::Scope& Stack::nearestScope() {
         Stack* s = this;
-        map<ustring, Stack::Entry>* t = table;
+        Scope* t = table;
         while (s->_parent && !t) {
             s = s->_parent;
             t = s->table;
@@ -533,11 +810,11 @@ namespace basil {
         return *t;
     }
     
-    const map<ustring, Stack::Entry>& Stack::scope() const {
+    const Stack::Scope& Stack::scope() const {
         return *table;
     }
     
-    map<ustring, Stack::Entry>& Stack::scope() {
+    Stack::Scope& Stack::scope() {
         return *table;
     }
     
@@ -614,7 +891,8 @@ namespace basil {
     }
 
     Value::Value(u32 line, u32 column, const ValueClass* vc):
-        _line(line), _column(column), _valueclass(vc), _cachetype(nullptr) {
+        _line(line), _column(column), _valueclass(vc), _cachetype(nullptr), 
+        _refs(1) {
         //
     }
 
@@ -622,6 +900,19 @@ namespace basil {
         //
     }
 
+    // Values whose type and fold don't depend on context are immutable once
+    // constructed, so their clone() can return another reference to the same
+    // node. Owners must release() children rather than deleting them.
+
+    Value* Value::share() const {
+        ++ _refs;
+        return (Value*)this;
+    }
+
+    void Value::release() {
+        if (-- _refs == 0) delete this;
+    }
+
     u32 Value::line() const {
         return _line;
     }
@@ -642,8 +933,27 @@ namespace basil {
         return nullptr;
     }
 
+    // Type checking can't leave anything to runtime code, so running out
+    // of fuel since the given marks is an error rather than an exhaustion. 
+    // Nested checks report it only once, for the innermost value.
+    static bool starvedSince(u64 starving, u32 exhausts) {
+        static u64 reported = 0;
+        if (starved() == starving || starved() == reported) return false;
+        reported = starved();
+        dropExhaustions(exhausts);
+        return true;
+    }
+
     const Type* Value::type(Stack& ctx) {
-        if (!_cachetype) setType(lazyType(ctx));
+        if (!_cachetype) {
+            u64 starving = starved();
+            u32 exhausts = exhaustions().size();
+            setType(lazyType(ctx));
+            if (starvedSince(starving, exhausts)) {
+                err(PHASE_TYPE, line(), column(),
+                    "Ran out of fuel while computing the type of '", this, "'.");
+            }
+        }
         return _cachetype;
     }
 
@@ -659,6 +969,100 @@ namespace basil {
         return true;
     }
 
+    bool Value::foldConstants(Stack& ctx, bool calls) {
+        return false;
+    }
+
+    static bool constant(const Value* v) {
+        return v->is<IntegerConstant>() || v->is<RationalConstant>() 
+            || v->is<StringConstant>() || v->is<BoolConstant>();
+    }
+
+    // Whether v is a complete operator tree over constants. Such a tree
+    // means the same thing in any scope, so clones can share it whole.
+    static bool immutable(const Value* v) {
+        if (constant(v) || v->is<CharConstant>()) return true;
+        if (v->is<BinaryMath>() || v->is<BinaryLogic>() 
+            || v->is<BinaryEquality>() || v->is<BinaryRelation>() 
+            || v->is<Join>()) {
+            const BinaryOp* op = (const BinaryOp*)v;
+            return op->left() && op->right() 
+                && immutable(op->left()) && immutable(op->right());
+        }
+        if (v->is<Not>()) {
+            const Not* op = (const Not*)v;
+            return op->operand() && immutable(op->operand());
+        }
+        return false;
+    }
+
+    static bool constantType(const Type* t) {
+        return t == I64 || t == DOUBLE || t == STRING || t == BOOL;
+    }
+
+    // Folds the children of v, then replaces v itself with a constant if
+    // it's pure and all of its operands are known.
+    static Value* foldConstant(Stack& ctx, Value* v, bool calls) {
+        if (!v || constant(v)) return v;
+        if (!v->foldConstants(ctx, calls) || !v->pure(ctx)) return v;
+        const Type* t = v->type(ctx);
+        if (!constantType(t)) return v;
+        refuel(v->line(), v->column());
+        Meta m = v->fold(ctx);
+        if (!m || m.type() != t) return v;
+
+        Value* c;
+        if (t == I64) c = new IntegerConstant(m.asInt(), v->line(), v->column());
+        else if (t == DOUBLE) 
+            c = new RationalConstant(m.asFloat(), v->line(), v->column());
+        else if (t == STRING) 
+            c = new StringConstant(m.asString(), v->line(), v->column());
+        else c = new BoolConstant(m.asBool(), v->line(), v->column());
+        v->release();
+        return c;
+    }
+
+    // Fuel
+
+    // a maxfuel of zero means evaluation is unlimited
+    static u64 maxfuel = 0, fuel = 0, _starved = 0;
+    static Exhaustion fuelroot = { 0, 0 };
+    static vector<Exhaustion> _exhaustions;
+
+    void setFuel(u64 f) {
+        maxfuel = fuel = f;
+    }
+
+    void refuel(u32 line, u32 column) {
+        fuel = maxfuel;
+        fuelroot = { line, column };
+    }
+
+    bool burn(u64 amount) {
+        if (!maxfuel) return true;
+        if (amount < fuel) return fuel -= amount, true;
+        if (fuel) _exhaustions.push(fuelroot), fuel = 0;
+        ++ _starved;
+        return false;
+    }
+
+    bool exhausted() {
+        return maxfuel && !fuel;
+    }
+
+    // The number of burns denied so far.
+    u64 starved() {
+        return _starved;
+    }
+
+    const vector<Exhaustion>& exhaustions() {
+        return _exhaustions;
+    }
+
+    void dropExhaustions(u32 count) {
+        while (_exhaustions.size() > count) _exhaustions.pop();
+    }
+
     // Builtin
 
     const ValueClass Builtin::CLASS(Value::CLASS);
@@ -695,7 +1099,7 @@ namespace basil {
     }
 
     Value* Void::clone(Stack& ctx) const {
-        return new Void(line(), column());
+        return share();
     }
 
     void Void::repr(stream& io) const {
@@ -727,7 +1131,7 @@ namespace basil {
     }
 
     Value* Empty::clone(Stack& ctx) const {
-        return new Empty(line(), column());
+        return share();
     }
 
     void Empty::repr(stream& io) const {
@@ -763,7 +1167,7 @@ namespace basil {
     }
 
     Value* IntegerConstant::clone(Stack& ctx) const {
-        return new IntegerConstant(_value, line(), column());
+        return share();
     }
 
     void IntegerConstant::repr(stream& io) const {
@@ -799,7 +1203,7 @@ namespace basil {
     }
 
     Value* RationalConstant::clone(Stack& ctx) const {
-        return new RationalConstant(_value, line(), column());
+        return share();
     }
 
     void RationalConstant::repr(stream& io) const {
@@ -834,7 +1238,7 @@ namespace basil {
     }
 
     Value* StringConstant::clone(Stack& ctx) const {
-        return new StringConstant(_value, line(), column());
+        return share();
     }
 
     void StringConstant::repr(stream& io) const {
@@ -866,7 +1270,7 @@ namespace basil {
     }
 
     Value* CharConstant::clone(Stack& ctx) const {
-        return new CharConstant(_value, line(), column());
+        return share();
     }
 
     void CharConstant::repr(stream& io) const {
@@ -897,7 +1301,7 @@ namespace basil {
     }
 
     Value* TypeConstant::clone(Stack& ctx) const {
-        return new TypeConstant(_value, line(), column());
+        return share();
     }
 
     void TypeConstant::repr(stream& io) const {
@@ -932,7 +1336,7 @@ namespace basil {
     }
 
     Value* BoolConstant::clone(Stack& ctx) const {
-        return new BoolConstant(_value, line(), column());
+        return share();
     }
 
     void BoolConstant::repr(stream& io) const {
@@ -971,7 +1375,7 @@ namespace basil {
 
     Value* Quote::clone(Stack& ctx) const {
         if (!_term) return new Quote(line(), column());
-        return new Quote(_term, line(), column());
+        return share();
     }
 
     bool Quote::canApply(Stack& ctx, Value* v) const {
@@ -1008,7 +1412,7 @@ namespace basil {
     }
 
     Value* Incomplete::clone(Stack& ctx) const {
-        return new Incomplete(_term, line(), column());
+        return share();
     }
 
     void Incomplete::repr(stream& io) const {
@@ -1080,6 +1484,11 @@ namespace basil {
         return !e->reassigned();
     }
 
+    bool Variable::foldConstants(Stack& ctx, bool calls) {
+        auto e = entry(ctx);
+        return e && e->known() && !e->reassigned() && e->value();
+    }
+
     // Interaction
 
     const ValueClass Interaction::CLASS(Value::CLASS);
@@ -1101,7 +1510,7 @@ namespace basil {
     }
 
     Value* Interaction::clone(Stack& ctx) const {
-        return new Interaction(_fn, line(), column());
+        return share();
     }
 
     void Interaction::repr(stream& io) const {
@@ -1123,7 +1532,7 @@ namespace basil {
     }
 
     Sequence::~Sequence() {
-        for (Value* v : _children) if (v) delete v;
+        for (Value* v : _children) if (v) v->release();
     }
 
     const vector<Value*>& Sequence::children() const {
@@ -1180,6 +1589,11 @@ namespace basil {
         return true;
     }
 
+    bool Sequence::foldConstants(Stack& ctx, bool calls) {
+        for (Value*& v : _children) v = foldConstant(ctx, v, calls);
+        return false;
+    }
+
     // Program
     
     const ValueClass Program::CLASS(Value::CLASS);
@@ -1195,7 +1609,7 @@ namespace basil {
     }
 
     Program::~Program() {
-        for (Value* v : _children) if (v) delete v;
+        for (Value* v : _children) if (v) v->release();
     }
 
     const vector<Value*>& Program::children() const {
@@ -1252,6 +1666,70 @@ namespace basil {
         return true;
     }
 
+    bool Program::foldConstants(Stack& ctx, bool calls) {
+        for (Value*& v : _children) v = foldConstant(ctx, v, calls);
+        return false;
+    }
+
+    // Collects every name reachable from the values it explores, following
+    // calls into the instances they were resolved to.
+    class Reachable : public Explorer {
+    public:
+        set<ustring> names;
+        vector<ustring> pending;
+        set<Lambda*> insts;
+        virtual void visit(Value* v) override {
+            if (v->is<Variable>()) {
+                const ustring& name = v->as<Variable>()->name();
+                if (names.find(name) == names.end()) {
+                    names.insert(name);
+                    pending.push(name);
+                }
+            }
+            else if (v->is<Call>()) {
+                Lambda* inst = v->as<Call>()->instance();
+                if (inst && insts.find(inst) == insts.end()) {
+                    insts.insert(inst);
+                    inst->explore(*this);
+                }
+            }
+        }
+    };
+
+    static const ustring* removableName(Stack& ctx, Value* v) {
+        if (!v->is<Autodefine>()) return nullptr;
+        Autodefine* def = v->as<Autodefine>();
+        if (!def->name()->is<Variable>() || !def->init()->pure(ctx)) 
+            return nullptr;
+        return &def->name()->as<Variable>()->name();
+    }
+
+    void Program::eliminateDead(Stack& ctx) {
+        map<ustring, Value*> defs;
+        Reachable reachable;
+        for (Value* v : _children) {
+            const ustring* name = removableName(ctx, v);
+            if (name && defs.find(*name) == defs.end()) 
+                defs.put(*name, v->as<Autodefine>()->init());
+            else v->explore(reachable);
+        }
+        while (reachable.pending.size()) {
+            ustring name = reachable.pending.back();
+            reachable.pending.pop();
+            auto it = defs.find(name);
+            if (it != defs.end()) it->second->explore(reachable);
+        }
+
+        vector<Value*> live;
+        for (Value* v : _children) {
+            const ustring* name = removableName(ctx, v);
+            if (name && reachable.names.find(*name) == reachable.names.end())
+                v->release();
+            else live.push(v);
+        }
+        _children = live;
+    }
+
     // Lambda
 
     const ValueClass Lambda::CLASS(Builtin::CLASS);
@@ -1280,13 +1758,18 @@ namespace basil {
         
     Lambda::Lambda(u32 line, u32 column, const ValueClass* vc):
         Builtin(line, column, vc), _ctx(nullptr), _bodyscope(nullptr),
-        _body(nullptr), _match(nullptr), _inlined(false) {
+        _body(nullptr), _match(nullptr), _term(nullptr), 
+        _inlined(false), _gathered(false), _closed(false),
+        _purity(PURITY_UNKNOWN), _puritydepth(0), _purityepoch(0),
+        _calls(0), _memo(nullptr), _specs(nullptr) {
         setType(find<FunctionType>(ANY, ANY, true));
     }
 
     Lambda::~Lambda() {
-        if (_match) delete _match;
-        if (_body) delete _body;
+        if (_match) _match->release();
+        if (_body) _body->release();
+        if (_memo) delete _memo;
+        if (_specs) delete _specs;
     }
 
     bool Lambda::canApply(Stack& ctx, Value* arg) const {
@@ -1327,8 +1810,7 @@ namespace basil {
                 if (args->top()->is<Variable>())
                     argt = ANY;
                 else if (args->top()->is<Define>()) {
-                    if (args->scope().find(args->top()->as<Define>()->name()) 
-                        == args->scope().end())
+                    if (!args->scope().has(args->top()->as<Define>()->name()))
                         args->top()->as<Define>()->apply(*args, nullptr);
                     argt = args->top()->type(*args);
                 }
@@ -1344,11 +1826,11 @@ namespace basil {
                          args->top()->column(),
                          "Found: ", args->top());
                 }
-                if (_match->is<Quote>()) delete _match;
+                if (_match->is<Quote>()) _match->release();
                 _match = args->top();
             }
             else if (args->size() == 0) {
-                delete _match;
+                _match->release();
                 _match = new Void(line(), column());
             }
             _ctx = args;
@@ -1359,11 +1841,12 @@ namespace basil {
             if (argt != ANY) {
                 Stack* body = new Stack(_ctx);
                 catchErrors();
-                _body->as<Quote>()->term()->eval(*body);
+                _term = _body->as<Quote>()->term();
+                _term->eval(*body);
                 if (!countErrors()) {
                     vector<Value*> bodyvals;
                     for (Value* v : *body) bodyvals.push(v);
-                    delete _body;
+                    _body->release();
                     _body = bodyvals.size() == 1 ? bodyvals[0]
                         : new Sequence(bodyvals, line(), column());
                     updateType(ctx);
@@ -1414,6 +1897,132 @@ namespace basil {
         return _ctx;
     }
 
+    // Body purity is computed once per lambda, and recomputed only after
+    // some variable has been reassigned. Recursive calls are assumed to be
+    // pure while their callee is pending; a result that leans on that 
+    // assumption for an enclosing lambda is cached only once the enclosing
+    // lambda's own result is known.
+    static u32 puritydepth = 0, pureassumed = 0xffffffff;
+
+    bool Lambda::pureBody() {
+        if (!_body) return true;
+        if (_purity == PURITY_PENDING) {
+            if (_puritydepth < pureassumed) pureassumed = _puritydepth;
+            return true;
+        }
+        if (_purity != PURITY_UNKNOWN 
+            && _purityepoch == Stack::Entry::reassignments())
+            return _purity == PURITY_PURE;
+
+        u32 outer = pureassumed;
+        pureassumed = 0xffffffff;
+        _purity = PURITY_PENDING;
+        _puritydepth = puritydepth ++;
+        bool result = _body->pure(*_ctx);
+        puritydepth --;
+
+        if (!result || pureassumed >= _puritydepth) {
+            _purity = result ? PURITY_PURE : PURITY_IMPURE;
+            _purityepoch = Stack::Entry::reassignments();
+            pureassumed = outer;
+        }
+        else {
+            _purity = PURITY_UNKNOWN;
+            if (outer < pureassumed) pureassumed = outer;
+        }
+        return result;
+    }
+
+    static u32 hotcalls = 64;
+    static const u32 MEMO_MAX = 1 << 16;
+
+    void setHotCalls(u32 calls) {
+        hotcalls = calls;
+    }
+
+    // Whether the body reads only its parameters, builtins and functions.
+    // The memo table is keyed on the argument alone, so a body reading any
+    // other enclosing or captured binding could be answered stale.
+    bool Lambda::closed() const {
+        if (!_gathered) return false;
+        const Stack* ctx = _ctx;
+        for (const ustring& var : _freevars) {
+            const Stack* s = ctx->findenv(var);
+            if (!s) continue;
+            const Stack::Entry& e = *(*s)[var];
+            if (s->depth() >= _ctx->depth() && e.storage() != STORAGE_CAPTURE)
+                continue;
+            if (e.builtin()) continue;
+            if (e.value().isFunction() || e.value().isIntersect()) continue;
+            return false;
+        }
+        return true;
+    }
+
+    bool Lambda::hot() {
+        if (!hotcalls) return false;
+        if (_calls < hotcalls) return _calls ++, false;
+        if (!_match->is<Variable>() && !_match->is<Define>()) return false;
+        if (_match->type(*_ctx)->is<ReferenceType>()) return false;
+        return _closed && pureBody() && _purity == PURITY_PURE;
+    }
+
+    static bool scalar(const Meta& m) {
+        return m.isInt() || m.isFloat() || m.isBool();
+    }
+
+    const Meta* Lambda::memoized(const Meta& arg) const {
+        if (!_memo) return nullptr;
+        auto it = _memo->find(arg);
+        return it == _memo->end() ? nullptr : &it->second;
+    }
+
+    void Lambda::memoize(const Meta& arg, const Meta& result) {
+        if (!_memo) _memo = new map<Meta, Meta>();
+        if (_memo->size() < MEMO_MAX) _memo->put(arg, result);
+    }
+
+    static u32 maxspecializations = 64, specializations = 64;
+
+    void setSpecializations(u32 budget) {
+        maxspecializations = specializations = budget;
+    }
+
+    void respecialize() {
+        specializations = maxspecializations;
+    }
+
+    // Clones this lambda for a constant argument, binding the argument's
+    // value into the clone so its body can be folded around it.
+    Lambda* Lambda::specialize(Stack& ctx, const Meta& arg) {
+        if (_specs) {
+            auto it = _specs->find(arg);
+            if (it != _specs->end()) return it->second;
+        }
+        if (!specializations || !_term || !_match->is<Define>()) return nullptr;
+        const Type* at = _match->type(*_ctx);
+        if (at->is<ReferenceType>()) return nullptr;
+
+        Stack* p = self()->parent();
+        Lambda* n = new Lambda(line(), column());
+        n->apply(*p, new Define(new TypeConstant(at, 0, 0), 
+                                _match->as<Define>()->name()));
+        n->apply(*p, new Quote(_term, line(), column()));
+        if (!_specs) _specs = new map<Meta, Lambda*>();
+        if (n->_body->is<Quote>()) {
+            _specs->put(arg, nullptr);
+            return nullptr;
+        }
+        _specs->put(arg, n);
+        specializations --;
+        n->complete(ctx);
+        Stack::Entry* param = n->_match->entry(*n->_ctx);
+        param->value() = arg;
+        param->known() = true;
+        n->_body = foldConstant(*n->_ctx, n->_body, true);
+        return n;
+    }
+
     Stack* Lambda::self() {
         return _ctx->parent();
     }
@@ -1432,40 +2041,37 @@ namespace basil {
             && _body->is<Quote>()) {
             Stack* body = _bodyscope;
             body->clear();
-            _body->as<Quote>()->term()->eval(*body);
+            _term = _body->as<Quote>()->term();
+            _term->eval(*body);
             vector<Value*> bodyvals;
             for (Value* v : *body) bodyvals.push(v);
-            delete _body;
+            _body->release();
             _body = bodyvals.size() == 1 ? bodyvals[0]
                 : new Sequence(bodyvals, line(), column());
             updateType(*_ctx);
         }
 
-        GatherVars gatherer;
-        _body->explore(gatherer);
-
-        _captures = map<ustring, Stack::Entry>();
-        for (const ustring& var : gatherer.vars) {
-            const Stack* s = ctx.findenv(var);
-            if (s && s->parent()
-                && s->depth() < _ctx->depth()) 
-                _captures.put(var, *(*s)[var]);
+        // the names a body refers to don't change once it's evaluated, so
+        // they're only gathered once, however often captures are rebound
+        if (!_gathered) {
+            GatherVars gatherer;
+            _body->explore(gatherer);
+            _freevars.clear();
+            for (const ustring& var : gatherer.vars) _freevars.push(var);
+            _gathered = !_body->is<Quote>();
         }
 
-        for (auto& p : _captures) {
-            if (p.second.builtin()) 
-                self()->bind(p.first, p.second.type(), p.second.builtin());
-            else
-                self()->bind(p.first, p.second.type());
-            (*self())[p.first]->value() = p.second.value();
-            (*self())[p.first]->storage() = STORAGE_CAPTURE;
+        for (const ustring& var : _freevars) {
+            const Stack* s = ctx.findenv(var);
+            if (!s || !s->parent() || s->depth() >= _ctx->depth()) continue;
+            Stack::Entry e = *(*s)[var];
+            if (e.builtin()) self()->bind(var, e.type(), e.builtin());
+            else self()->bind(var, e.type());
+            Stack::Entry* capture = (*self())[var];
+            capture->value() = e.value();
+            capture->storage() = STORAGE_CAPTURE;
         }
-
-        // print(_stdout, (Value*)this, " closes on { ");
-        // for (const ustring& s : _captures) {
-        //     print(_stdout, s, " ");
-        // }
-        // println(_stdout, "}");
+        _closed = closed();
     }
         
     void Lambda::format(stream& io, u32 level) const {
@@ -1554,6 +2160,20 @@ namespace basil {
         if (_body) _body->explore(e);
     }
 
+    // Generic lambdas have no body to fold until they're instantiated, so
+    // their instances are folded in their place.
+    bool Lambda::foldConstants(Stack& ctx, bool calls) {
+        if (!_match || !_body) return false;
+        if (type(ctx)->as<FunctionType>()->arg() != ANY 
+            && !_body->is<Quote>()) {
+            _body = foldConstant(*_ctx, _body, calls);
+        }
+        for (auto& p : insts) if (p.second != this) {
+            p.second->foldConstants(ctx, calls);
+        }
+        return false;
+    }
+
     void Lambda::instantiate(const Type* t, Lambda* l) {
         insts.put(t, l);
     }
@@ -1579,33 +2199,30 @@ namespace basil {
 
     Lambda* instantiate(Stack& callctx, Lambda* l, const Type* at) {
         if (auto existing = l->instance(at)) return existing;
+        Stack* p = l->self()->parent();
+        const Term* term = nullptr;
+        if (l->body()->is<Quote>()) {
+            term = l->body()->as<Quote>()->term();
+            if (Lambda* shared = p->instance(term, at)) {
+                l->instantiate(at, shared);
+                return shared;
+            }
+        }
         ustring name = "";
         if (l->match()->is<Variable>()) name = l->match()->as<Variable>()->name();
         if (l->match()->is<Define>()) name = l->match()->as<Define>()->name();
         Lambda* n = new Lambda(l->line(), l->column());
         Define* arg = new Define(new TypeConstant(at, 0, 0), name);
-        Stack* p = l->self()->parent();
         n->apply(*p, arg);
         n->apply(*p, l->body()->clone(*p));
         n->complete(callctx);
         l->instantiate(at, n);
+        if (term) p->addInstance(term, at, n);
         return n;
     }
 
     Lambda* instantiate(Stack& callctx, Lambda* l, Value* a) {
-        const Type* at = a->type(callctx);
-        if (auto existing = l->instance(at)) return existing;
-        ustring name = "";
-        if (l->match()->is<Variable>()) name = l->match()->as<Variable>()->name();
-        if (l->match()->is<Define>()) name = l->match()->as<Define>()->name();
-        Lambda* n = new Lambda(l->line(), l->column());
-        Define* arg = new Define(new TypeConstant(at, 0, 0), name);
-        Stack* p = l->self()->parent();
-        n->apply(*p, arg);
-        n->apply(*p, l->body()->clone(*p));
-        n->complete(callctx);
-        l->instantiate(at, n);
-        return n;
+        return instantiate(callctx, l, a->type(callctx));
     }
 
     const Type* Call::lazyType(Stack& ctx) {
@@ -1657,8 +2274,12 @@ namespace basil {
     }
 
     Call::~Call() {
-        delete _func;
-        if (_arg) delete _arg;
+        _func->release();
+        if (_arg) _arg->release();
+    }
+
+    Lambda* Call::instance() const {
+        return inst ? inst->as<Lambda>() : nullptr;
     }
 
     void Call::format(stream& io, u32 level) const {
@@ -1668,12 +2289,26 @@ namespace basil {
         if (_arg) _arg->format(io, level + 1);
     }
 
-    Meta Call::fold(Stack& ctx) {
-        if (inst) {
-            Lambda* l = inst->as<Lambda>();
-            assign(*l->scope(), l->match(), _arg);
-            return l->body()->fold(*l->scope());
+    Meta Call::foldBody(Lambda* l) {
+        Stack& scope = *l->scope();
+        if (!l->hot()) {
+            assign(scope, l->match(), _arg);
+            return l->body()->fold(scope);
+        }
+
+        Meta arg = _arg->fold(scope);
+        if (scalar(arg)) {
+            if (const Meta* m = l->memoized(arg)) return *m;
         }
+        assign(scope, l->match(), _arg, arg);
+        Meta m = l->body()->fold(scope);
+        if (scalar(arg) && scalar(m)) l->memoize(arg, m);
+        return m;
+    }
+
+    Meta Call::fold(Stack& ctx) {
+        if (!burn()) return Meta();
+        if (inst) return foldBody(inst->as<Lambda>());
 
         Lambda* l = nullptr;
         Meta m = _func->fold(ctx);
@@ -1705,8 +2340,7 @@ namespace basil {
                 inst = l = instantiate(ctx, l, _arg);
             }
             auto backup = l->scope()->scope();
-            assign(*l->scope(), l->match(), _arg);
-            Meta m = l->body()->fold(*l->scope());
+            Meta m = foldBody(l);
             l->scope()->scope() = backup;
             return m;
         }
@@ -1773,7 +2407,30 @@ namespace basil {
             l = instantiate(ctx, l, _arg);
         }
 
-        return _arg->pure(ctx) && l->body()->pure(*l->scope());
+        return _arg->pure(ctx) && l->pureBody();
+    }
+
+    bool Call::foldConstants(Stack& ctx, bool calls) {
+        if (!_arg) return false;
+        _arg = foldConstant(ctx, _arg, calls);
+        if (!calls || !constant(_arg)) return false;
+        if (pure(ctx) && constantType(type(ctx))) return true;
+
+        // calls that won't fold away outright still get a copy of the 
+        // callee specialized for their constant argument
+        Lambda* l = inst ? inst->as<Lambda>() : nullptr;
+        if (!l) {
+            Meta m = _func->fold(ctx);
+            if (m.isFunction() && m.asFunction().value()->is<Lambda>())
+                l = m.asFunction().value()->as<Lambda>();
+        }
+        if (l && l->type(ctx)->as<FunctionType>()->arg() != ANY) {
+            if (Lambda* s = l->specialize(ctx, _arg->fold(ctx))) inst = s;
+        }
+
+        // true only says the operands are constant: an impure call still
+        // gets here, and foldConstant() won't fold it since it checks pure()
+        return true;
     }
 
     // BinaryOp
@@ -1787,8 +2444,8 @@ namespace basil {
     }
 
     BinaryOp::~BinaryOp() {
-        if (lhs) delete lhs;
-        if (rhs) delete rhs;
+        if (lhs) lhs->release();
+        if (rhs) rhs->release();
     }
 
     const Value* BinaryOp::left() const {
@@ -1841,6 +2498,13 @@ namespace basil {
         return lhs->pure(ctx) && rhs->pure(ctx);
     }
 
+    bool BinaryOp::foldConstants(Stack& ctx, bool calls) {
+        if (!lhs || !rhs) return false;
+        lhs = foldConstant(ctx, lhs, calls);
+        rhs = foldConstant(ctx, rhs, calls);
+        return constant(lhs) && constant(rhs);
+    }
+
     // UnaryOp
 
     const ValueClass UnaryOp::CLASS(Builtin::CLASS);
@@ -1852,7 +2516,7 @@ namespace basil {
     }
 
     UnaryOp::~UnaryOp() {
-        if (_operand) delete _operand;
+        if (_operand) _operand->release();
     }
 
     const Value* UnaryOp::operand() const {
@@ -1895,6 +2559,12 @@ namespace basil {
         return _operand->pure(ctx);
     }
 
+    bool UnaryOp::foldConstants(Stack& ctx, bool calls) {
+        if (!_operand) return false;
+        _operand = foldConstant(ctx, _operand, calls);
+        return constant(_operand);
+    }
+
     // BinaryMath
 
     const ValueClass BinaryMath::CLASS(BinaryOp::CLASS);
@@ -2018,6 +2688,7 @@ namespace basil {
     }
 
     Value* Add::clone(Stack& ctx) const {
+        if (immutable(this)) return share();
         Add* node = new Add(line(), column());
         if (lhs) node->apply(ctx, lhs);
         if (rhs) node->apply(ctx, rhs);
@@ -2046,6 +2717,7 @@ namespace basil {
     }
 
     Value* Subtract::clone(Stack& ctx) const {
+        if (immutable(this)) return share();
         Subtract* node = new Subtract(line(), column());
         if (lhs) node->apply(ctx, lhs);
         if (rhs) node->apply(ctx, rhs);
@@ -2074,6 +2746,7 @@ namespace basil {
     }
 
     Value* Multiply::clone(Stack& ctx) const {
+        if (immutable(this)) return share();
         Multiply* node = new Multiply(line(), column());
         if (lhs) node->apply(ctx, lhs);
         if (rhs) node->apply(ctx, rhs);
@@ -2102,6 +2775,7 @@ namespace basil {
     }
 
     Value* Divide::clone(Stack& ctx) const {
+        if (immutable(this)) return share();
         Divide* node = new Divide(line(), column());
         if (lhs) node->apply(ctx, lhs);
         if (rhs) node->apply(ctx, rhs);
@@ -2130,6 +2804,7 @@ namespace basil {
     }
 
     Value* Modulus::clone(Stack& ctx) const {
+        if (immutable(this)) return share();
         Modulus* node = new Modulus(line(), column());
         if (lhs) node->apply(ctx, lhs);
         if (rhs) node->apply(ctx, rhs);
@@ -2195,6 +2870,7 @@ namespace basil {
     }
 
     Value* And::clone(Stack& ctx) const {
+        if (immutable(this)) return share();
         And* node = new And(line(), column());
         if (lhs) node->apply(ctx, lhs);
         if (rhs) node->apply(ctx, rhs);
@@ -2223,6 +2899,7 @@ namespace basil {
     }
 
     Value* Or::clone(Stack& ctx) const {
+        if (immutable(this)) return share();
         Or* node = new Or(line(), column());
         if (lhs) node->apply(ctx, lhs);
         if (rhs) node->apply(ctx, rhs);
@@ -2251,6 +2928,7 @@ namespace basil {
     }
 
     Value* Xor::clone(Stack& ctx) const {
+        if (immutable(this)) return share();
         Xor* node = new Xor(line(), column());
         if (lhs) node->apply(ctx, lhs);
         if (rhs) node->apply(ctx, rhs);
@@ -2286,6 +2964,7 @@ namespace basil {
     }
 
     Value* Not::clone(Stack& ctx) const {
+        if (immutable(this)) return share();
         Not* node = new Not(line(), column());
         if (_operand) node->apply(ctx, _operand);
         return node;
@@ -2369,6 +3048,7 @@ namespace basil {
     }
 
     Value* Equal::clone(Stack& ctx) const {
+        if (immutable(this)) return share();
         Equal* node = new Equal(line(), column());
         if (lhs) node->apply(ctx, lhs);
         if (rhs) node->apply(ctx, rhs);
@@ -2396,6 +3076,7 @@ namespace basil {
     }
 
     Value* Inequal::clone(Stack& ctx) const {
+        if (immutable(this)) return share();
         Inequal* node = new Inequal(line(), column());
         if (lhs) node->apply(ctx, lhs);
         if (rhs) node->apply(ctx, rhs);
@@ -2477,6 +3158,7 @@ namespace basil {
     }
 
     Value* Less::clone(Stack& ctx) const {
+        if (immutable(this)) return share();
         Less* node = new Less(line(), column());
         if (lhs) node->apply(ctx, lhs);
         if (rhs) node->apply(ctx, rhs);
@@ -2504,6 +3186,7 @@ namespace basil {
     }
 
     Value* LessEqual::clone(Stack& ctx) const {
+        if (immutable(this)) return share();
         LessEqual* node = new LessEqual(line(), column());
         if (lhs) node->apply(ctx, lhs);
         if (rhs) node->apply(ctx, rhs);
@@ -2531,6 +3214,7 @@ namespace basil {
     }
 
     Value* Greater::clone(Stack& ctx) const {
+        if (immutable(this)) return share();
         Greater* node = new Greater(line(), column());
         if (lhs) node->apply(ctx, lhs);
         if (rhs) node->apply(ctx, rhs);
@@ -2558,6 +3242,7 @@ namespace basil {
     }
 
     Value* GreaterEqual::clone(Stack& ctx) const {
+        if (immutable(this)) return share();
         GreaterEqual* node = new GreaterEqual(line(), column());
         if (lhs) node->apply(ctx, lhs);
         if (rhs) node->apply(ctx, rhs);
@@ -2584,8 +3269,8 @@ namespace basil {
     }
 
     ArrayDef::~ArrayDef() {
-        if (_type) delete _type;
-        if (_dim) delete _dim;
+        if (_type) _type->release();
+        if (_dim) _dim->release();
     }
 
     void ArrayDef::format(stream& io, u32 level) const {
@@ -2669,6 +3354,12 @@ namespace basil {
         else print(io, _type, _dim);
     }
 
+    void ArrayDef::explore(Explorer& e) {
+        e.visit(this);
+        if (_type) _type->explore(e);
+        if (_dim) _dim->explore(e);
+    }
+
     // Array
 
     const ValueClass Array::CLASS(Builtin::CLASS);
@@ -2680,7 +3371,7 @@ namespace basil {
     }
 
     Array::~Array() {
-        for (Value* v : elts) delete v;
+        for (Value* v : elts) v->release();
     }
 
     void Array::format(stream& io, u32 level) const {
@@ -2696,8 +3387,15 @@ namespace basil {
         v->as<Quote>()->term()->eval(*tmp);
         for (Value* v : *tmp) elts.push(v);
         vector<const Type*> ts;
-        for (Value* v : elts) ts.push(v->type(ctx));
-        setType(find<ArrayType>(unionOf(ts), elts.size()));
+        u32 count = 0;
+        for (Value* v : elts) {
+            if (v->is<IntegerRange>()) {
+                if (v->as<IntegerRange>()->count()) ts.push(I64);
+                count += v->as<IntegerRange>()->count();
+            }
+            else ts.push(v->type(ctx)), count ++;
+        }
+        setType(find<ArrayType>(unionOf(ts), count));
         return this;
     }
 
@@ -2705,15 +3403,34 @@ namespace basil {
         if (type(ctx)->is<FunctionType>()) 
             return Meta(type(ctx), new MetaFunction(this));
         
-        vector<Meta> metas;
         const ArrayType* mytype = type(ctx)->as<ArrayType>();
+        if (elts.size() == 1 && elts[0]->is<IntegerRange>()) 
+            return Meta(type(ctx), new MetaArray(
+                elts[0]->as<IntegerRange>()->first(), 
+                elts[0]->as<IntegerRange>()->count()));
+
+        if (!burn(elts.size())) return Meta();
+        MetaArray* a = new MetaArray();
+        Meta result(type(ctx), a);
         for (Value* v : elts) {
+            if (v->is<IntegerRange>()) {
+                IntegerRange* r = v->as<IntegerRange>();
+                if (!burn(r->count())) return Meta();
+                for (u32 i = 0; i < r->count(); i ++) {
+                    Meta m(I64, r->first() + i);
+                    if (mytype->element() != I64)
+                        m = Meta(mytype->element(), new MetaUnion(m));
+                    a->push(m);
+                }
+                continue;
+            }
+            Meta m = v->fold(ctx);
+            if (!m) return Meta();
             if (v->type(ctx) != mytype->element())
-                metas.push(Meta(mytype->element(), new MetaUnion(v->fold(ctx))));
-            else metas.push(v->fold(ctx));
+                m = Meta(mytype->element(), new MetaUnion(m));
+            a->push(m);
         }
-        for (Meta& m : metas) if (!m) return Meta();
-        return Meta(type(ctx), new MetaArray(metas));
+        return result;
     }
 
     Value* Array::clone(Stack& ctx) const {
@@ -2731,6 +3448,11 @@ namespace basil {
         print(io, "]");
     }
 
+    void Array::explore(Explorer& e) {
+        e.visit(this);
+        for (Value* v : elts) v->explore(e);
+    }
+
     bool Array::lvalue(Stack& ctx) {
         if (elts.size() == 0) return false;
         return type(ctx)->as<ArrayType>()->element()->is<ReferenceType>();
@@ -2755,8 +3477,8 @@ namespace basil {
     }
 
     Index::~Index() {
-        if (arr) delete arr;
-        if (idx) delete idx;
+        if (arr) arr->release();
+        if (idx) idx->release();
     }
 
     void Index::format(stream& io, u32 level) const {
@@ -2788,21 +3510,48 @@ namespace basil {
         if (!arr || !idx) 
             return Meta(type(ctx), new MetaFunction(this));
         
-        Meta a = arr->fold(ctx);
-        Meta i = idx->fold(ctx);
+        // read through the const accessors, so shared arrays aren't copied
+        const Meta a = arr->fold(ctx);
+        const Meta i = idx->fold(ctx);
         if (!a || !i) return Meta();
         
-        if (i.asArray().size() == 1) {
-            return Meta(type(ctx), a.asArray()[i.asArray()[0].asInt()]);
+        const MetaArray& is = i.asArray();
+        const MetaArray* from = &a.asArray();
+        bool picked = from->lazy();
+        if (picked) {
+            // a lazy range has no element to refer to, so keep copies of
+            // just the ones read, in index order
+            vector<Meta> read;
+            for (const Meta& m : is) read.push((*from)[m.asInt()]);
+            _read = Meta(a.type(), new MetaArray(read));
+            from = &_read.asArray();
+        }
+        
+        if (is.size() == 1) {
+            u32 k = picked ? 0 : is[0].asInt();
+            return Meta(type(ctx), (Meta&)from->at(k));
         }
         else {
             vector<Meta> ms;
-            for (const Meta& m : i.asArray())
-                ms.push(Meta(type(ctx), a.asArray()[m.asInt()]));
+            for (u32 j = 0; j < is.size(); j ++) {
+                u32 k = picked ? j : is[j].asInt();
+                ms.push(Meta(type(ctx), (Meta&)from->at(k)));
+            }
             return Meta(type(ctx), new MetaArray(ms));
         }
     }
 
+    // Writes go through the mutable accessor, which copies shared nodes
+    // and materializes lazy ranges.
+    bool Index::store(Stack& ctx, const Meta& value) {
+        if (!arr || !idx) return false;
+        Meta a = arr->fold(ctx);
+        const Meta i = idx->fold(ctx);
+        if (!a || !i || i.asArray().size() != 1) return false;
+        a.asArray()[i.asArray()[0].asInt()] = value;
+        return true;
+    }
+
     Value* Index::clone(Stack& ctx) const {
         Index* i = new Index(line(), column());
         if (arr) i->apply(ctx, arr->clone(ctx));
@@ -2816,6 +3565,12 @@ namespace basil {
         else print(io, arr, idx);
     }
 
+    void Index::explore(Explorer& e) {
+        e.visit(this);
+        if (arr) arr->explore(e);
+        if (idx) idx->explore(e);
+    }
+
     bool Index::lvalue(Stack& ctx) {
         return arr && idx;
     }
@@ -2854,10 +3609,15 @@ namespace basil {
                     "Bounds of range expression must be constant.");
             }
             Meta l = lhs->fold(ctx), r = rhs->fold(ctx);
-            for (i64 i = l.asInt(); i <= r.asInt(); i ++)
-                ctx.push(new IntegerConstant(i, line(), column()));
+            if (!l.isInt() || !r.isInt()) {
+                delete this;
+                return nullptr;
+            }
+            i64 count = r.asInt() < l.asInt() ? 0 : r.asInt() - l.asInt() + 1;
+            Value* range = new IntegerRange(l.asInt(), count, 
+                                            line(), column());
             delete this;
-            return nullptr;
+            return range;
         }
         return this;
     }
@@ -2868,6 +3628,41 @@ namespace basil {
         return r;
     }
 
+    // IntegerRange
+
+    const ValueClass IntegerRange::CLASS(Value::CLASS);
+
+    IntegerRange::IntegerRange(i64 first, u32 count, u32 line, u32 column, 
+                               const ValueClass* vc):
+        Value(line, column, vc), _first(first), _count(count) {
+        setType(find<ArrayType>(I64, count));
+    }
+
+    i64 IntegerRange::first() const {
+        return _first;
+    }
+
+    u32 IntegerRange::count() const {
+        return _count;
+    }
+
+    void IntegerRange::format(stream& io, u32 level) const {
+        indent(io, level);
+        println(io, "Range ", _first, " ", _first + _count - 1);
+    }
+
+    Meta IntegerRange::fold(Stack& ctx) {
+        return Meta(type(ctx), new MetaArray(_first, _count));
+    }
+
+    Value* IntegerRange::clone(Stack& ctx) const {
+        return share();
+    }
+
+    void IntegerRange::repr(stream& io) const {
+        print(io, _first, " .. ", _first + _count - 1);
+    }
+
     // Repeat
 
     const ValueClass Repeat::CLASS(BinaryOp::CLASS);
@@ -2895,10 +3690,11 @@ namespace basil {
                 return nullptr;
             }
             Meta m = arg->fold(ctx);
-            for (int i = 0; i < m.asInt(); i ++) {
+            for (int i = 1; i < m.asInt(); i ++) {
                 ctx.push(lhs->clone(ctx));
             }
-            delete arg;
+            if (m.asInt() > 0) ctx.push(lhs), lhs = nullptr;
+            arg->release();
             delete this;
             return nullptr;
         }
@@ -2964,8 +3760,12 @@ namespace basil {
                     "Cannot take reference to non-lvalue.");
                 setType(ERROR);
             }
-            else _operand = arg,
+            else {
+                // the referenced variable may now change through the reference
+                if (auto e = arg->entry(ctx)) e->reassign();
+                _operand = arg;
                 setType(find<ReferenceType>(_operand->type(ctx)));
+            }
         }
         return this;
     }
@@ -2987,6 +3787,10 @@ namespace basil {
         return true;
     }
 
+    bool Reference::foldConstants(Stack& ctx, bool calls) {
+        return false; // operand must stay an lvalue
+    }
+
     // Join
 
     const Type* Join::_BASE_TYPE;
@@ -3032,6 +3836,7 @@ namespace basil {
     }
 
     Value* Join::clone(Stack& ctx) const {
+        if (immutable(this)) return share();
         Join* node = new Join(line(), column());
         if (lhs) node->apply(ctx, lhs);
         if (rhs) node->apply(ctx, rhs);
@@ -3147,8 +3952,17 @@ namespace basil {
         }
     }
 
+    void Intersect::getCases(vector<Lambda*>& cases) {
+        if (lhs && lhs->is<Lambda>()) cases.push(lhs->as<Lambda>());
+        else if (lhs && lhs->is<Intersect>()) 
+            lhs->as<Intersect>()->getCases(cases);
+        if (rhs && rhs->is<Lambda>()) cases.push(rhs->as<Lambda>());
+        else if (rhs && rhs->is<Intersect>()) 
+            rhs->as<Intersect>()->getCases(cases);
+    }
+
     Intersect::Intersect(u32 line, u32 column, const ValueClass* vc):
-        BinaryOp("&", line, column, vc) {
+        BinaryOp("&", line, column, vc), _opencase(0), _flattened(false) {
         setType(BASE_TYPE());
     }
 
@@ -3163,6 +3977,7 @@ namespace basil {
     }
     
     Value* Intersect::apply(Stack& ctx, Value* arg) {
+        _flattened = false;
         if (!lhs) {
             lhs = arg;
             if (lhs->type(ctx) == TYPE) setType(find<FunctionType>(TYPE, TYPE));
@@ -3326,43 +4141,38 @@ namespace basil {
         }
     }
 
-    Constraint lambdaMatches(Lambda* fn, Stack& ctx, const Meta& value) {
-        const FunctionType* ft = fn->type(ctx)->as<FunctionType>();
-        if (auto match = ft->matches(value)) return match;
-        return Constraint::NONE;
+    // Flattens the whole tree of cases into a table of the values matched 
+    // by equality constraints, plus the first case that matches any value. 
+    // Cases are tried leftmost-first, so value cases after the first open 
+    // case can never be selected and are left out.
+    void Intersect::flatten(Stack& ctx) {
+        _cases.clear();
+        _valuecases = map<Meta, u32>();
+        getCases(_cases);
+        _opencase = _cases.size();
+        for (u32 i = 0; i < _cases.size(); i ++) {
+            auto& cons = _cases[i]->type(ctx)->
+                as<FunctionType>()->constraints();
+            if (!cons.size()) _opencase = i;
+            for (const Constraint& con : cons) {
+                if (con.type() == UNKNOWN || con.type() == OF_TYPE) 
+                    _opencase = i;
+            }
+            if (_opencase == i) break;
+            for (const Constraint& con : cons) {
+                if (con.type() == EQUALS_VALUE 
+                    && _valuecases.find(con.value()) == _valuecases.end())
+                    _valuecases[con.value()] = i;
+            }
+        }
+        _flattened = true;
     }
 
     Lambda* Intersect::caseFor(Stack& ctx, const Meta& value) {
-        auto it = _casecache.find(value);
-        if (it != _casecache.end()) return it->second;
-
-        Lambda *l = nullptr, *r = nullptr;
-        Constraint left = Constraint::NONE, right = Constraint::NONE;
-        if (lhs->is<Lambda>()) {
-            left = lambdaMatches(lhs->as<Lambda>(), ctx, value);
-            l = lhs->as<Lambda>();
-        }
-        if (rhs->is<Lambda>()) {
-            right = lambdaMatches(rhs->as<Lambda>(), ctx, value);
-            r = rhs->as<Lambda>();
-        }
-        if (lhs->is<Intersect>()) {
-            l = lhs->as<Intersect>()->caseFor(ctx, value);
-            left = l ? maxMatch(l->type(ctx)->as<FunctionType>()
-                ->constraints(), value) : Constraint::NONE;
-        }
-        if (rhs->is<Intersect>()) {
-            r = rhs->as<Intersect>()->caseFor(ctx, value);
-            right = r ? maxMatch(r->type(ctx)->as<FunctionType>()
-                ->constraints(), value) : Constraint::NONE;
-        }
-
-        if (!left && !right) return nullptr;
-        else if (left) return _casecache[value] = l;
-        else if (right) return _casecache[value] = r;
-        else if (left.precedes(right) || 
-            (left.type() != UNKNOWN && right.type() == UNKNOWN)) return _casecache[value] = l;
-        else return _casecache[value] = r;
+        if (!_flattened) flatten(ctx);
+        auto it = _valuecases.find(value);
+        if (it != _valuecases.end()) return _cases[it->second];
+        return _opencase < _cases.size() ? _cases[_opencase] : nullptr;
     }
 
     Location* Intersect::gen(Stack& ctx, CodeGenerator& gen, CodeFrame& frame) {
@@ -3446,6 +4256,10 @@ namespace basil {
         return node;
     }
 
+    // Loop and if bodies being evaluated. Their definitions may run any
+    // number of times, with values compile-time evaluation can't predict.
+    static u32 branching = 0;
+
     // If
 
     const ValueClass If::CLASS(Builtin::CLASS);
@@ -3456,8 +4270,8 @@ namespace basil {
     }
 
     If::~If() {
-        if (cond) delete cond;
-        if (body) delete body;
+        if (cond) cond->release();
+        if (body) body->release();
     }
 
     Meta If::fold(Stack& ctx) {
@@ -3474,7 +4288,9 @@ namespace basil {
         }
         else if (!body) {
             Stack* temp = new Stack(&ctx);
+            ++ branching;
             arg->as<Quote>()->term()->eval(*temp);
+            -- branching;
             vector<Value*> vals;
             for (Value* v : *temp) vals.push(v);
             body = new Sequence(vals, arg->line(), arg->column());
@@ -3503,11 +4319,24 @@ namespace basil {
         else print(io, "(if ", cond, ": ", body, ")");
     }
 
+    void If::explore(Explorer& e) {
+        e.visit(this);
+        if (cond) cond->explore(e);
+        if (body) body->explore(e);
+    }
+
     bool If::pure(Stack& ctx) const {
         if (!cond || !body) return true;
         return cond->pure(ctx) && body->pure(ctx);
     }
 
+    bool If::foldConstants(Stack& ctx, bool calls) {
+        if (!cond || !body) return false;
+        cond = foldConstant(ctx, cond, calls);
+        body = foldConstant(ctx, body, calls);
+        return false;
+    }
+
     // While
 
     const ValueClass While::CLASS(Builtin::CLASS);
@@ -3518,14 +4347,17 @@ namespace basil {
     }
 
     While::~While() {
-        if (cond) delete cond;
-        if (body) delete body;
+        if (cond) cond->release();
+        if (body) body->release();
     }
 
     Meta While::fold(Stack& ctx) {
         if (!cond || !body) return Meta(type(ctx), new MetaFunction(this));
         Meta c = cond->fold(ctx);
-        while (c.asBool()) body->fold(ctx), c = cond->fold(ctx);
+        while (c.asBool()) {
+            if (!burn()) return Meta();
+            body->fold(ctx), c = cond->fold(ctx);
+        }
         return Meta(VOID);
     }
 
@@ -3536,7 +4368,9 @@ namespace basil {
         }
         else if (!body) {
             Stack* temp = new Stack(&ctx);
+            ++ branching;
             arg->as<Quote>()->term()->eval(*temp);
+            -- branching;
             vector<Value*> vals;
             for (Value* v : *temp) vals.push(v);
             body = new Sequence(vals, arg->line(), arg->column());
@@ -3565,6 +4399,12 @@ namespace basil {
         else print(io, "(while ", cond, ": ", body, ")");
     }
 
+    void While::explore(Explorer& e) {
+        e.visit(this);
+        if (cond) cond->explore(e);
+        if (body) body->explore(e);
+    }
+
     Location* While::gen(Stack& ctx, CodeGenerator& gen, CodeFrame& frame) {
         ustring start = gen.newLabel(), end = gen.newLabel();
         frame.add(new Label(start, false));
@@ -3576,6 +4416,7 @@ namespace basil {
         body->gen(ctx, gen, frame);
         frame.add(new GotoInsn(start));
         frame.add(new Label(end, false));
+        return frame.none();
     }
 
     bool While::pure(Stack& ctx) const {
@@ -3583,6 +4424,13 @@ namespace basil {
         return false;
     }
 
+    bool While::foldConstants(Stack& ctx, bool calls) {
+        if (!cond || !body) return false;
+        cond = foldConstant(ctx, cond, calls);
+        body = foldConstant(ctx, body, calls);
+        return false;
+    }
+
     // Define
 
     const ValueClass Define::CLASS(Builtin::CLASS);
@@ -3594,7 +4442,7 @@ namespace basil {
     }
 
     Define::~Define() {
-        if (_type) delete _type;
+        if (_type) _type->release();
     }
 
     const ustring& Define::name() const {
@@ -3608,13 +4456,21 @@ namespace basil {
     }
 
     Value* Define::apply(Stack& ctx, Value* arg) {
+        u64 starving = starved();
+        u32 exhausts = exhaustions().size();
         Meta fr = _type->fold(ctx);
-        if (!fr.isType()) {
+        if (starvedSince(starving, exhausts)) {
+            err(PHASE_TYPE, line(), column(),
+                "Ran out of fuel while evaluating type expression '", 
+                _type, "'.");
+            setType(ERROR);
+        }
+        else if (!fr.isType()) {
             err(PHASE_TYPE, line(), column(),
                 "Expected type expression, got '", fr, "'.");
             setType(ERROR);
         }
-        else if (ctx.nearestScope().find(_name) != ctx.nearestScope().end()) {
+        else if (ctx.declared(_name)) {
             err(PHASE_TYPE, line(), column(),
                 "Redefinition of variable '", _name, "'.");
             setType(ERROR);
@@ -3676,8 +4532,16 @@ namespace basil {
     }
 
     Autodefine::~Autodefine() {
-        if (_name) delete _name;
-        if (_init) delete _init;
+        if (_name) _name->release();
+        if (_init) _init->release();
+    }
+
+    Value* Autodefine::name() const {
+        return _name;
+    }
+
+    Value* Autodefine::init() const {
+        return _init;
     }
 
     void Autodefine::format(stream& io, u32 level) const {
@@ -3687,10 +4551,21 @@ namespace basil {
         if (_init) _init->format(io, level + 1);
     }
 
+    // Whether name, just bound to src, holds its runtime value: either src
+    // is a constant expression, or it's pure and bound once, in straight-line
+    // top-level code. Function and loop locals are otherwise only as good as
+    // the last compile-time evaluation that touched them.
+    static bool knownBinding(Stack& ctx, const ustring& name, Value* src) {
+        if (immutable(src)) return true;
+        const Stack* s = ctx.findenv(name);
+        bool toplevel = s && s->parent() && !s->parent()->parent();
+        return toplevel && !branching && src->pure(ctx);
+    }
+
     void bind(Stack& ctx, Value* dst, Value* src) {
         if (dst->is<Variable>()) {
             const ustring& name = dst->as<Variable>()->name();
-            if (ctx.nearestScope().find(name) != ctx.nearestScope().end()) {
+            if (ctx.declared(name)) {
                 err(PHASE_TYPE, dst->line(), dst->column(),
                     "Redefinition of variable '", name, "'.");
                 return;
@@ -3703,6 +4578,7 @@ namespace basil {
             else if (src->fold(ctx)) {
                 ctx[name]->value() = src->fold(ctx);
             }
+            ctx[name]->known() = knownBinding(ctx, name, src);
             if (src->is<Lambda>()) {
                 src->as<Lambda>()->bindrec(name, src->type(ctx),
                     src->fold(ctx));
@@ -3817,6 +4693,11 @@ namespace basil {
         return !_init || _init->pure(ctx);
     }
 
+    bool Autodefine::foldConstants(Stack& ctx, bool calls) {
+        if (_init) _init = foldConstant(ctx, _init, calls);
+        return false;
+    }
+
     // Assign
 
     const ValueClass Assign::CLASS(Builtin::CLASS);
@@ -3827,8 +4708,8 @@ namespace basil {
     }
 
     Assign::~Assign() {
-        if (lhs) delete lhs;
-        if (rhs) delete rhs;
+        if (lhs) lhs->release();
+        if (rhs) rhs->release();
     }
 
     void assign(Stack& ctx, Value* dst, Value* src) {
@@ -3845,17 +4726,18 @@ namespace basil {
             assign(ctx, dst->as<Join>()->right(), src->as<Join>()->right());
         }
         else if (dst->is<Variable>() || dst->is<Define>()) {
-            if (auto val = src->entry(ctx)) {
-                auto entry = dst->entry(ctx);
-                if (val->builtin()) entry->builtin() = val->builtin();
-                if (val->value()) entry->value() = val->value();
-            }
-            else if (src->fold(ctx)) {
-                auto entry = dst->entry(ctx);
-                entry->value() = src->fold(ctx);
-            }
+            assign(ctx, dst, src, src->entry(ctx) ? Meta() : src->fold(ctx));
         }
     }
+
+    void assign(Stack& ctx, Value* dst, Value* src, const Meta& value) {
+        if (auto val = src->entry(ctx)) {
+            auto entry = dst->entry(ctx);
+            if (val->builtin()) entry->builtin() = val->builtin();
+            if (val->value()) entry->value() = val->value();
+        }
+        else if (value) dst->entry(ctx)->value() = value;
+    }
     
     Value* Assign::apply(Stack& ctx, Value* arg) {
         if (!lhs) {
@@ -3973,6 +4855,8 @@ namespace basil {
 
     Meta Assign::fold(Stack& ctx) {
         if (!lhs || !rhs) return Meta();
+        if (lhs->is<Index>() && lhs->as<Index>()->store(ctx, rhs->fold(ctx)))
+            return Meta(VOID);
         Meta l = lhs->fold(ctx);
         if (l.isRef()) l.asRef() = rhs->fold(ctx);
         else lhs->entry(ctx)->value() = rhs->fold(ctx);
@@ -3983,6 +4867,11 @@ namespace basil {
         return !lhs || !rhs || (lhs->is<Define>() && rhs->pure(ctx));
     }
 
+    bool Assign::foldConstants(Stack& ctx, bool calls) {
+        if (lhs && rhs) rhs = foldConstant(ctx, rhs, calls);
+        return false;
+    }
+
     // Print
 
     const Type* Print::_BASE_TYPE;
@@ -4170,6 +5059,11 @@ namespace basil {
         return _src->pure(ctx);
     }
 
+    bool Cast::foldConstants(Stack& ctx, bool calls) {
+        _src = foldConstant(ctx, _src, calls);
+        return constant(_src);
+    }
+
     // Eval
 
     const ValueClass Eval::CLASS(Builtin::CLASS);
@@ -4246,7 +5140,7 @@ namespace basil {
 
     MetaEval::MetaEval(u32 line, u32 column, 
             const ValueClass* vc):
-        Builtin(line, column, vc) {
+        Builtin(line, column, vc), _pending(false) {
         setType(find<FunctionType>(ANY, ANY));
     }
 
@@ -4255,11 +5149,141 @@ namespace basil {
         println("meta");
     }
 
+    static u32 metaworkers = 0;
+
+    void setMetaWorkers(u32 workers) {
+        metaworkers = workers;
+    }
+
+    struct PendingMeta {
+        MetaEval* eval;
+        Value* v;
+        Stack* ctx;
+    };
+
+    static vector<PendingMeta> pendingMetas;
+
+    // What a worker folds for v: the operand of a print, since printing
+    // has to wait for the results to be committed in order.
+    static Value* metaFolded(Value* v) {
+        return v->is<Print>() ? v->as<Print>()->operand() : v;
+    }
+
+    // Pure expressions can't affect each other, so a worker can fold one
+    // in its own copy of the compiler. Only scalar results are sent back.
+    static bool parallelMeta(Stack& ctx, Value* v) {
+        Value* f = metaFolded(v);
+        if (!f || !f->pure(ctx)) return false;
+        const Type* t = f->type(ctx);
+        return t->is<NumericType>() || t == BOOL;
+    }
+
+    struct MetaResult {
+        u8 ok, isfloat;
+        i64 i;
+        double d;
+    };
+
+    // Forks a worker that folds f and writes a MetaResult to the returned
+    // pipe. A result is only ok if the fold finished without errors, and 
+    // its type already existed here, since the worker's address space is a
+    // copy of this one.
+    static int forkMeta(Stack& ctx, Value* f) {
+        int fds[2];
+        if (pipe(fds) != 0) return -1;
+        pid_t pid = fork();
+        if (pid < 0) {
+            close(fds[0]), close(fds[1]);
+            return -1;
+        }
+        if (pid == 0) {
+            close(fds[0]);
+            u32 errors = countErrors();
+            refuel(f->line(), f->column());
+            Meta m = f->fold(ctx);
+            MetaResult r = { 0, 0, 0, 0.0 };
+            if (m && !exhausted() && countErrors() == errors 
+                && m.type() == f->type(ctx)) {
+                r.ok = m.isInt() || m.isFloat() || m.isBool();
+                r.isfloat = m.isFloat();
+                if (m.isInt()) r.i = m.asInt();
+                else if (m.isFloat()) r.d = m.asFloat();
+                else if (m.isBool()) r.i = m.asBool();
+            }
+            if (write(fds[1], &r, sizeof(r)) != sizeof(r)) _exit(1);
+            _exit(0); // skips destructors, which would flush our output
+        }
+        close(fds[1]);
+        return fds[0];
+    }
+
+    static bool joinMeta(int fd, MetaResult& r) {
+        bool ok = fd >= 0 && read(fd, &r, sizeof(r)) == sizeof(r) && r.ok;
+        if (fd >= 0) close(fd);
+        wait(nullptr);
+        return ok;
+    }
+
+    void flushMeta() {
+        // taken first, since committing a result may queue or flush more
+        vector<PendingMeta> pending = pendingMetas;
+        pendingMetas.clear();
+        for (u32 i = 0; i < pending.size(); i += metaworkers) {
+            u32 n = pending.size() - i;
+            if (n > metaworkers) n = metaworkers;
+            vector<int> fds;
+            for (u32 j = 0; j < n; j ++) {
+                const PendingMeta& p = pending[i + j];
+                fds.push(forkMeta(*p.ctx, metaFolded(p.v)));
+            }
+            for (u32 j = 0; j < n; j ++) {
+                const PendingMeta& p = pending[i + j];
+                MetaResult r;
+                if (joinMeta(fds[j], r)) {
+                    const Type* t = metaFolded(p.v)->type(*p.ctx);
+                    Meta m = r.isfloat ? Meta(t, r.d) 
+                        : t == BOOL ? Meta(t, bool(r.i)) : Meta(t, r.i);
+                    p.eval->commit(*p.ctx, p.v, &m);
+                }
+                else p.eval->commit(*p.ctx, p.v, nullptr); // fold it here
+                p.v->release();
+            }
+        }
+    }
+
     Value* MetaEval::apply(Stack& ctx, Value* v) {
-        val = v->fold(ctx);
+        if (metaworkers && parallelMeta(ctx, v)) {
+            _pending = true;
+            pendingMetas.push({ this, v->share(), &ctx });
+            return this;
+        }
+        flushMeta();
+        commit(ctx, v, nullptr);
         return this;
     }
 
+    // Sets this expression's value, from a worker's result if there is 
+    // one, and otherwise by folding v in place.
+    void MetaEval::commit(Stack& ctx, Value* v, const Meta* folded) {
+        _pending = false;
+        if (folded && v->is<Print>()) {
+            println(_stdout, *folded);
+            val = Meta(VOID);
+            return;
+        }
+        if (folded) {
+            val = *folded;
+            return;
+        }
+        refuel(v->line(), v->column());
+        val = v->fold(ctx);
+        if (exhausted()) {
+            err(PHASE_TYPE, v->line(), v->column(),
+                "Ran out of fuel while evaluating meta expression.");
+            val = Meta();
+        }
+    }
+
     Value* MetaEval::clone(Stack& ctx) const {
         return new MetaEval(line(), column());
     }
@@ -4269,6 +5293,7 @@ namespace basil {
     }
 
     Meta MetaEval::fold(Stack& ctx) {
+        if (_pending) flushMeta();
         return val;
     }
 
@@ -4287,7 +5312,7 @@ namespace basil {
     }
 
     Use::~Use() {
-        if (path) delete path;
+        if (path) path->release();
         if (src) delete src;
         if (env) delete env;
         if (module) delete module;